@@ -0,0 +1,200 @@
+#include "FrameSequence.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+using namespace std;
+
+// Sets up the frames of a filename pattern.
+FrameSequence::FrameSequence(const string& pattern, int firstFrame, int lastFrame, int prefetchCount)
+    : pattern(pattern), firstFrame(firstFrame), lastFrame(lastFrame), prefetchCount(max(1, prefetchCount)),
+      decodedFrames(0) {
+};
+
+// Gets the filename of a frame.
+string FrameSequence::frameFilename(const string& pattern, int frame) {
+    size_t start = pattern.rfind('#');
+    if (start == string::npos) {
+        return pattern;
+    }
+    size_t end = start + 1;
+    while (start > 0 && pattern[start - 1] == '#') {
+        --start;
+    }
+
+    string number = to_string(frame);
+    if (number.size() < end - start) {
+        number.insert(0, end - start - number.size(), '0');
+    }
+    return pattern.substr(0, start) + number + pattern.substr(end);
+};
+
+// Calls function for every frame, with a loader thread decoding ahead.
+bool FrameSequence::forEachWindow(int windowSize, WindowFunction function) {
+    windowSize = max(1, windowSize);
+    decodedFrames = 0;
+
+    // Defining a structure to hold a frame the loader has finished with.
+    struct LoadedFrame {
+        bool loaded;
+        TGAImage image;
+    };
+
+    // State shared with the loader thread.
+    mutex lock;
+    condition_variable changed;
+    deque<LoadedFrame> ready;
+    bool stopping = false;
+
+    thread loader([&]() {
+        for (int frame = firstFrame; frame <= lastFrame; ++frame) {
+            // Waits for room before decoding, so the frame being decoded counts towards prefetchCount too.
+            {
+                unique_lock<mutex> guard(lock);
+                changed.wait(guard, [&]() { return stopping || static_cast<int>(ready.size()) < prefetchCount; });
+                if (stopping) {
+                    return;
+                }
+            }
+
+            // Loads into a buffer that left the window if there is one, frames are usually all one size.
+            LoadedFrame loadedFrame;
+            loadedFrame.image = pool.acquire(0, 0);
+            loadedFrame.loaded = loadedFrame.image.loadImage(frameFilename(pattern, frame));
+
+            // Only this thread adds frames, so the room it waited for is still there.
+            lock_guard<mutex> guard(lock);
+            if (stopping) {
+                return;
+            }
+            ready.push_back(move(loadedFrame));
+            changed.notify_all();
+            if (!ready.back().loaded) {
+                return;
+            }
+        }
+    });
+
+    deque<TGAImage> window;
+    bool success = true;
+    for (int frame = firstFrame; frame <= lastFrame && success; ++frame) {
+        // Waits for the loader to hand over the next frame.
+        LoadedFrame loadedFrame;
+        {
+            unique_lock<mutex> guard(lock);
+            changed.wait(guard, [&]() { return !ready.empty(); });
+            loadedFrame = move(ready.front());
+            ready.pop_front();
+            changed.notify_all();
+        }
+
+        if (!loadedFrame.loaded) {
+            cout << "Error: Failed to load frame " << frameFilename(pattern, frame) << "." << endl;
+            success = false;
+            break;
+        }
+        ++decodedFrames;
+
+        if (!window.empty() && (loadedFrame.image.getWidth() != window.back().getWidth() ||
+                                loadedFrame.image.getHeight() != window.back().getHeight())) {
+            cout << "Error: Frame " << frame << " isn't the same size as the frames before it." << endl;
+            success = false;
+            break;
+        }
+
+        // Slides the window, keeping the frame that left alive until the function has seen it.
+        window.push_back(move(loadedFrame.image));
+        TGAImage leaving;
+        bool left = static_cast<int>(window.size()) > windowSize;
+        if (left) {
+            leaving = move(window.front());
+            window.pop_front();
+        }
+
+        vector<const TGAImage*> frames;
+        for (size_t i = 0; i < window.size(); ++i) {
+            frames.push_back(&window[i]);
+        }
+        success = function(frame, frames, left ? &leaving : nullptr);
+
+        if (left) {
+            pool.release(leaving);
+        }
+    }
+
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+        changed.notify_all();
+    }
+    loader.join();
+    return success;
+};
+
+// Runs a temporal operation over the sequence and saves the results.
+bool FrameSequence::process(TemporalOperation operation, int windowSize, const string& outputPattern, int threshold) {
+    // Differences and motion only ever look one frame back.
+    if (operation == FrameDifference || operation == MotionMask) {
+        windowSize = 2;
+    }
+
+    // Per-channel sums of the window for the running average, updated as frames enter and leave it.
+    vector<unsigned int> sums;
+    TGAImage result;
+
+    return forEachWindow(windowSize, [&](int frame, const vector<const TGAImage*>& window, const TGAImage* leaving) {
+        const TGAImage& current = *window.back();
+        int width = current.getWidth();
+        int valueCount = width * current.getHeight() * 3;
+        result.resize(width, current.getHeight());
+
+        const unsigned char* newest = current.view().data;
+        const unsigned char* previous = window.size() > 1 ? window[window.size() - 2]->view().data : newest;
+        unsigned char* destination = result.view().data;
+
+        if (operation == FrameDifference) {
+            TGAImage::differenceImages(current.view(), window.front()->view(), result.view());
+        } else if (operation == MotionMask) {
+            parallelRows(current.getHeight(), [=](int firstRow, int endRow) {
+                for (int i = firstRow * width * 3; i < endRow * width * 3; i += 3) {
+                    int change = max(abs(newest[i] - previous[i]),
+                                     max(abs(newest[i + 1] - previous[i + 1]), abs(newest[i + 2] - previous[i + 2])));
+                    unsigned char mask = change > threshold ? 255 : 0;
+                    destination[i] = mask;
+                    destination[i + 1] = mask;
+                    destination[i + 2] = mask;
+                }
+            });
+        } else if (operation == RunningAverage) {
+            // Adds the new frame and takes away the one that left, so the cost doesn't grow with the window.
+            sums.resize(valueCount);
+            unsigned int* sum = sums.data();
+            const unsigned char* oldest = leaving != nullptr ? leaving->view().data : nullptr;
+            unsigned int count = static_cast<unsigned int>(window.size());
+            parallelRows(current.getHeight(), [=](int firstRow, int endRow) {
+                for (int i = firstRow * width * 3; i < endRow * width * 3; ++i) {
+                    sum[i] += newest[i] - (oldest != nullptr ? oldest[i] : 0);
+                    destination[i] = static_cast<unsigned char>((sum[i] + count / 2) / count);
+                }
+            });
+        } else {
+            // The window is a stack of layers, so its median is the stacked median, written into the same buffer.
+            TGAImage::medianImages(window, result);
+        }
+
+        if (!result.saveImage(frameFilename(outputPattern, frame))) {
+            cout << "Error: Failed to save the result of frame " << frame << "." << endl;
+            return false;
+        }
+        return true;
+    });
+};
+
+// Gets the number of frames decoded by the last run.
+int FrameSequence::getDecodedFrames() const {
+    return decodedFrames;
+};
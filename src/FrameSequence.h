@@ -0,0 +1,62 @@
+#ifndef FRAME_SEQUENCE_H
+#define FRAME_SEQUENCE_H
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "ImagePool.h"
+#include "TGAImage.h"
+using namespace std;
+
+
+// Defining a class that streams a numbered range of frames, such as render_0001.tga to render_0240.tga,
+// through a sliding window. A loader thread decodes frames ahead of the one being processed, and each frame
+// is decoded once and kept while it is inside the window, so the window size doesn't change how much
+// decoding is done. Frames leaving the window hand their buffers back for the next frames to load into.
+//
+// Filename patterns mark the frame number with a run of '#', which is zero-padded to the length of the run:
+// "render_####.tga" gives render_0001.tga for frame 1. Filenames ending in .qoi are read and written as QOI.
+class FrameSequence {
+public:
+    // Temporal operations that process can run, each producing one result per frame.
+    enum TemporalOperation {
+        FrameDifference, // |frame - previous frame| per channel
+        RunningAverage,  // mean of the window per channel
+        RunningMedian,   // median of the window per channel
+        MotionMask       // white where any channel changed by more than the threshold since the previous frame
+    };
+
+    // Function called for every frame with the window of up to windowSize most recent frames, oldest first,
+    // and the frame that just left the window (nullptr if none did). Returns false to stop the sequence.
+    typedef function<bool(int frame, const vector<const TGAImage*>& window, const TGAImage* leaving)> WindowFunction;
+
+    // Sets up the frames firstFrame to lastFrame of a filename pattern. prefetchCount is how many frames
+    // the loader may decode ahead of the one being processed.
+    FrameSequence(const string& pattern, int firstFrame, int lastFrame, int prefetchCount = 2);
+
+    // Gets the filename of a frame, replacing the run of '#' in the pattern with the zero-padded number.
+    static string frameFilename(const string& pattern, int frame);
+
+    // Calls function for every frame in order. Returns false if a frame failed to load, frames
+    // changed size, or the function stopped the sequence.
+    bool forEachWindow(int windowSize, WindowFunction function);
+
+    // Runs a temporal operation over windows of windowSize frames and saves each result using outputPattern.
+    // Frames near the start use the frames available so far, and the first frame has no difference or motion.
+    bool process(TemporalOperation operation, int windowSize, const string& outputPattern, int threshold = 32);
+
+    // Gets the number of frames decoded by the last run.
+    int getDecodedFrames() const;
+
+private:
+    string pattern;
+    int firstFrame;
+    int lastFrame;
+    int prefetchCount;
+    int decodedFrames;
+
+    // Buffers of frames that left the window, reused by the loader.
+    ImagePool pool;
+};
+
+#endif // FRAME_SEQUENCE_H
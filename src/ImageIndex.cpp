@@ -0,0 +1,324 @@
+#include "ImageIndex.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <dirent.h>
+#include <sys/stat.h>
+using namespace std;
+
+namespace {
+
+const char INDEX_MAGIC[4] = { 'T', 'G', 'I', 'X' };
+const uint32_t INDEX_VERSION = 2;
+const int INDEX_HEADER_SIZE = 12;
+
+// Size of an entry after its path.
+const int ENTRY_FIELDS_SIZE = 43;
+
+// Entry flags. Unloadable is a flag of its own rather than a loadable one, so entries written before it
+// existed, which were all loadable, keep reading as loadable.
+const unsigned char FLAG_QOI = 1;
+const unsigned char FLAG_UNLOADABLE = 2;
+
+// Writes a little-endian value of the given number of bytes.
+inline void writeLittleEndian(vector<unsigned char>& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) {
+        out.push_back(static_cast<unsigned char>(value >> (8 * i)));
+    }
+};
+
+// Reads a little-endian value of the given number of bytes.
+inline uint64_t readLittleEndian(const unsigned char* in, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i) {
+        value |= static_cast<uint64_t>(in[i]) << (8 * i);
+    }
+    return value;
+};
+
+// Converts a file time to nanoseconds.
+inline long long nanoseconds(const timespec& time) {
+    return static_cast<long long>(time.tv_sec) * 1000000000LL + time.tv_nsec;
+};
+
+// Checks if a filename ends in .tga or .qoi, ignoring case.
+bool hasImageExtension(const string& filename) {
+    if (filename.size() < 4) {
+        return false;
+    }
+    string extension = filename.substr(filename.size() - 4);
+    transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension == ".tga" || extension == ".qoi";
+};
+
+// Adds the image files in a directory to files. Symbolic links to directories aren't followed,
+// so a link back up the tree can't make the scan go round in circles.
+bool listImageFiles(const string& directory, bool recursive, vector<string>& files) {
+    DIR* handle = opendir(directory.c_str());
+    if (handle == nullptr) {
+        cout << "Error: Failed to open the directory " << directory << "." << endl;
+        return false;
+    }
+
+    bool success = true;
+    string prefix = directory.empty() || directory[directory.size() - 1] == '/' ? directory : directory + "/";
+    for (dirent* item = readdir(handle); item != nullptr; item = readdir(handle)) {
+        string name = item->d_name;
+        if (name == "." || name == "..") {
+            continue;
+        }
+
+        string path = prefix + name;
+        struct stat info;
+        if (lstat(path.c_str(), &info) != 0) {
+            continue;
+        }
+        if (S_ISDIR(info.st_mode)) {
+            if (recursive) {
+                success = listImageFiles(path, recursive, files) && success;
+            }
+        } else if (hasImageExtension(name)) {
+            files.push_back(path);
+        }
+    }
+
+    closedir(handle);
+    return success;
+};
+
+// Orders entries by path, which find relies on.
+bool entryPathLess(const ImageIndex::Entry& entry, const string& path) {
+    return entry.path < path;
+};
+
+}
+
+ImageIndex::ImageIndex() : probedCount(0) {
+};
+
+// Lists the image files, then stats and probes them in parallel.
+bool ImageIndex::scan(const vector<string>& directories, bool recursive) {
+    bool success = true;
+    vector<string> files;
+    for (size_t i = 0; i < directories.size(); ++i) {
+        success = listImageFiles(directories[i], recursive, files) && success;
+    }
+    sort(files.begin(), files.end());
+    files.erase(unique(files.begin(), files.end()), files.end());
+
+    // Probing is mostly waiting on the disk, so files are handed out in small bands. Files that can't be
+    // loaded stay in the index with their header fields, flagged so the shape checks leave them out.
+    vector<Entry> found(files.size());
+    vector<char> readable(files.size(), 0);
+    atomic<int> probed(0);
+    parallelRows(static_cast<int>(files.size()), [&](int firstFile, int endFile) {
+        for (int i = firstFile; i < endFile; ++i) {
+            struct stat info;
+            if (stat(files[i].c_str(), &info) != 0 || !S_ISREG(info.st_mode)) {
+                continue;
+            }
+
+            Entry& entry = found[i];
+            entry.path = files[i];
+            entry.fileSize = info.st_size;
+            entry.modifiedTime = nanoseconds(info.st_mtim);
+            entry.changedTime = nanoseconds(info.st_ctim);
+            entry.inode = info.st_ino;
+
+            // Unchanged files keep what the index already says about them. The change time and inode also
+            // catch a rewrite that restored the old modification time or a file renamed over this one.
+            const Entry* known = find(files[i]);
+            if (known != nullptr && known->fileSize == entry.fileSize && known->modifiedTime == entry.modifiedTime &&
+                known->changedTime == entry.changedTime && known->inode == entry.inode) {
+                entry.info = known->info;
+                readable[i] = 1;
+            } else if (TGAImage::probeImage(files[i], entry.info)) {
+                readable[i] = 1;
+                ++probed;
+            }
+        }
+    }, 8);
+
+    vector<Entry> scanned;
+    scanned.reserve(files.size());
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (readable[i]) {
+            scanned.push_back(move(found[i]));
+        } else {
+            cout << "Skipping " << files[i] << ": its header couldn't be read." << endl;
+        }
+    }
+
+    entries.swap(scanned);
+    probedCount = probed.load();
+    return success;
+};
+
+// Saves the entries to an index file.
+bool ImageIndex::save(const string& filename) const {
+    vector<unsigned char> data(INDEX_MAGIC, INDEX_MAGIC + 4);
+    writeLittleEndian(data, INDEX_VERSION, 4);
+    writeLittleEndian(data, entries.size(), 4);
+
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const Entry& entry = entries[i];
+        if (entry.path.size() > 65535) {
+            cout << "Error: The path " << entry.path << " is too long for the index." << endl;
+            return false;
+        }
+        writeLittleEndian(data, entry.path.size(), 2);
+        data.insert(data.end(), entry.path.begin(), entry.path.end());
+        writeLittleEndian(data, static_cast<uint64_t>(entry.fileSize), 8);
+        writeLittleEndian(data, static_cast<uint64_t>(entry.modifiedTime), 8);
+        writeLittleEndian(data, static_cast<uint64_t>(entry.changedTime), 8);
+        writeLittleEndian(data, entry.inode, 8);
+        writeLittleEndian(data, static_cast<uint32_t>(entry.info.width), 4);
+        writeLittleEndian(data, static_cast<uint32_t>(entry.info.height), 4);
+        writeLittleEndian(data, static_cast<unsigned char>(entry.info.dataTypeCode), 1);
+        writeLittleEndian(data, static_cast<unsigned char>(entry.info.bitsPerPixel), 1);
+        writeLittleEndian(data, (entry.info.isQOI ? FLAG_QOI : 0) | (entry.info.loadable ? 0 : FLAG_UNLOADABLE), 1);
+    }
+
+    fstream file(filename, ios_base::out | ios_base::binary | ios_base::trunc);
+    if (!file || !file.write(reinterpret_cast<const char*>(data.data()), data.size())) {
+        cout << "Error: Failed to write the index " << filename << "." << endl;
+        return false;
+    }
+    return true;
+};
+
+// Loads the entries of an index file.
+bool ImageIndex::load(const string& filename) {
+    fstream file(filename, ios_base::in | ios_base::binary);
+    if (!file) {
+        return false;
+    }
+    vector<unsigned char> data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+
+    if (data.size() < static_cast<size_t>(INDEX_HEADER_SIZE) || memcmp(data.data(), INDEX_MAGIC, 4) != 0) {
+        cout << "Error: " << filename << " is not an image index." << endl;
+        return false;
+    }
+    if (readLittleEndian(&data[4], 4) != INDEX_VERSION) {
+        cout << "Error: The index " << filename << " was written by another version, so it isn't used." << endl;
+        return false;
+    }
+
+    size_t entryCount = static_cast<size_t>(readLittleEndian(&data[8], 4));
+    vector<Entry> loaded;
+    size_t position = INDEX_HEADER_SIZE;
+    for (size_t i = 0; i < entryCount; ++i) {
+        if (position + 2 > data.size()) {
+            break;
+        }
+        size_t pathLength = static_cast<size_t>(readLittleEndian(&data[position], 2));
+        position += 2;
+        if (position + pathLength + ENTRY_FIELDS_SIZE > data.size()) {
+            break;
+        }
+
+        Entry entry;
+        entry.path.assign(reinterpret_cast<const char*>(&data[position]), pathLength);
+        const unsigned char* fields = &data[position + pathLength];
+        entry.fileSize = static_cast<long long>(readLittleEndian(fields, 8));
+        entry.modifiedTime = static_cast<long long>(readLittleEndian(fields + 8, 8));
+        entry.changedTime = static_cast<long long>(readLittleEndian(fields + 16, 8));
+        entry.inode = readLittleEndian(fields + 24, 8);
+        entry.info.width = static_cast<int>(readLittleEndian(fields + 32, 4));
+        entry.info.height = static_cast<int>(readLittleEndian(fields + 36, 4));
+        entry.info.dataTypeCode = fields[40];
+        entry.info.bitsPerPixel = fields[41];
+        entry.info.isQOI = (fields[42] & FLAG_QOI) != 0;
+        entry.info.loadable = (fields[42] & FLAG_UNLOADABLE) == 0;
+        loaded.push_back(entry);
+        position += pathLength + ENTRY_FIELDS_SIZE;
+    }
+
+    if (loaded.size() != entryCount) {
+        cout << "Error: The index " << filename << " is truncated." << endl;
+        return false;
+    }
+
+    sort(loaded.begin(), loaded.end(), [](const Entry& a, const Entry& b) { return a.path < b.path; });
+    entries.swap(loaded);
+    return true;
+};
+
+const vector<ImageIndex::Entry>& ImageIndex::getEntries() const {
+    return entries;
+};
+
+// Finds the entry of a path with a binary search, entries are kept sorted by path.
+const ImageIndex::Entry* ImageIndex::find(const string& path) const {
+    vector<Entry>::const_iterator entry = lower_bound(entries.begin(), entries.end(), path, entryPathLess);
+    if (entry == entries.end() || entry->path != path) {
+        return nullptr;
+    }
+    return &*entry;
+};
+
+// Groups the loadable entries by dimensions, smallest first.
+vector<vector<size_t> > ImageIndex::groupByShape() const {
+    vector<size_t> order;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].info.loadable) {
+            order.push_back(i);
+        }
+    }
+
+    // Orders by pixel count, then width, keeping path order inside a group.
+    stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+        const TGAImageInfo& first = entries[a].info;
+        const TGAImageInfo& second = entries[b].info;
+        long long firstPixels = static_cast<long long>(first.width) * first.height;
+        long long secondPixels = static_cast<long long>(second.width) * second.height;
+        if (firstPixels != secondPixels) {
+            return firstPixels < secondPixels;
+        }
+        return first.width < second.width;
+    });
+
+    vector<vector<size_t> > groups;
+    for (size_t i = 0; i < order.size(); ++i) {
+        const TGAImageInfo& info = entries[order[i]].info;
+        if (groups.empty() || entries[groups.back()[0]].info.width != info.width ||
+            entries[groups.back()[0]].info.height != info.height) {
+            groups.push_back(vector<size_t>());
+        }
+        groups.back().push_back(order[i]);
+    }
+    return groups;
+};
+
+// Checks that every path is in the index, can be loaded, and all of them have the same dimensions.
+bool ImageIndex::checkSameShape(const vector<string>& paths) const {
+    const Entry* first = nullptr;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        const Entry* entry = find(paths[i]);
+        if (entry == nullptr) {
+            cout << "Error: " << paths[i] << " isn't in the index." << endl;
+            return false;
+        }
+        if (!entry->info.loadable) {
+            cout << "Error: " << paths[i] << " is a kind of image that can't be loaded." << endl;
+            return false;
+        }
+        if (first == nullptr) {
+            first = entry;
+        } else if (entry->info.width != first->info.width || entry->info.height != first->info.height) {
+            cout << "Error: Dimension mismatch between " << first->path << " and " << entry->path << "." << endl;
+            return false;
+        }
+    }
+    return true;
+};
+
+// Gets the number of headers the last scan read.
+int ImageIndex::getProbedCount() const {
+    return probedCount;
+};
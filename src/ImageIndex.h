@@ -0,0 +1,66 @@
+#ifndef IMAGE_INDEX_H
+#define IMAGE_INDEX_H
+
+#include <string>
+#include <vector>
+#include "TGAImage.h"
+using namespace std;
+
+
+// Defining a class that keeps the metadata of every .tga and .qoi file under some directories: path, file
+// size, modification and change times, inode, dimensions, type and bits per pixel. Only headers are read,
+// several files at a time, so a batch can be grouped by shape and mismatched inputs rejected before any
+// pixels are loaded.
+//
+// Index files are compact binary, all values little-endian:
+//   header (12 bytes)   "TGIX", version, entry count
+//   entries             path length (2), path, file size (8), modification time (8), change time (8),
+//                       inode (8), width (4), height (4), data type code (1), bits per pixel (1),
+//                       flags (1, bit 0: QOI, bit 1: can't be loaded)
+// Times are in nanoseconds. Rescanning with an index loaded only probes files whose size, times or inode
+// changed, so a file rewritten within the same second is still probed again.
+class ImageIndex {
+public:
+    // Defining a structure to hold the metadata of one file.
+    struct Entry {
+        string path;
+        long long fileSize;
+        long long modifiedTime;
+        long long changedTime;
+        unsigned long long inode;
+        TGAImageInfo info;
+    };
+
+    ImageIndex();
+
+    // Finds every image file in the directories (and their subdirectories when recursive) and replaces
+    // the entries with them, sorted by path. Files whose header can't be read are left out, and files
+    // loadImage would refuse are kept with info.loadable false. Returns false if a directory can't be opened.
+    bool scan(const vector<string>& directories, bool recursive = true);
+
+    // Saves the entries to an index file.
+    bool save(const string& filename) const;
+
+    // Loads the entries of an index file, replacing the current ones.
+    bool load(const string& filename);
+
+    const vector<Entry>& getEntries() const;
+
+    // Finds the entry of a path. Returns nullptr if the path isn't in the index.
+    const Entry* find(const string& path) const;
+
+    // Groups the loadable entries by dimensions, smallest first. Each group holds the indices of its entries.
+    vector<vector<size_t> > groupByShape() const;
+
+    // Checks that every path is in the index, can be loaded, and all of them have the same dimensions.
+    bool checkSameShape(const vector<string>& paths) const;
+
+    // Gets the number of headers the last scan read, the rest were unchanged since the index was loaded.
+    int getProbedCount() const;
+
+private:
+    vector<Entry> entries;
+    int probedCount;
+};
+
+#endif // IMAGE_INDEX_H
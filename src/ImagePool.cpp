@@ -0,0 +1,76 @@
+#include "ImagePool.h"
+using namespace std;
+
+// Gets an image of the given size, reusing the smallest pooled buffer that is big enough.
+TGAImage ImagePool::acquire(int width, int height) {
+    size_t bytesNeeded = static_cast<size_t>(width) * height * 3;
+    TGAImage image;
+
+    {
+        lock_guard<mutex> guard(lock);
+        int best = -1;
+        for (size_t i = 0; i < images.size(); ++i) {
+            if (images[i].getCapacity() >= bytesNeeded &&
+                (best < 0 || images[i].getCapacity() < images[best].getCapacity())) {
+                best = static_cast<int>(i);
+            }
+        }
+
+        if (best >= 0) {
+            image = move(images[best]);
+            images[best] = move(images.back());
+            images.pop_back();
+        }
+    }
+
+    image.resize(width, height);
+    return image;
+};
+
+// Gives an image's buffer back to the pool.
+void ImagePool::release(TGAImage& image) {
+    if (image.getCapacity() == 0) {
+        return;
+    }
+
+    lock_guard<mutex> guard(lock);
+    images.push_back(move(image));
+    image = TGAImage();
+};
+
+// Frees every pooled buffer.
+void ImagePool::clear() {
+    lock_guard<mutex> guard(lock);
+    images.clear();
+};
+
+// Frees the largest pooled buffers until the rest fit in maxBytes.
+void ImagePool::trim(size_t maxBytes) {
+    lock_guard<mutex> guard(lock);
+    size_t bytes = 0;
+    for (size_t i = 0; i < images.size(); ++i) {
+        bytes += images[i].getCapacity();
+    }
+
+    while (bytes > maxBytes) {
+        size_t largest = 0;
+        for (size_t i = 1; i < images.size(); ++i) {
+            if (images[i].getCapacity() > images[largest].getCapacity()) {
+                largest = i;
+            }
+        }
+        bytes -= images[largest].getCapacity();
+        images[largest] = move(images.back());
+        images.pop_back();
+    }
+};
+
+// Gets the number of bytes held by pooled buffers.
+size_t ImagePool::getPooledBytes() const {
+    lock_guard<mutex> guard(lock);
+    size_t bytes = 0;
+    for (size_t i = 0; i < images.size(); ++i) {
+        bytes += images[i].getCapacity();
+    }
+    return bytes;
+};
@@ -0,0 +1,35 @@
+#ifndef IMAGE_POOL_H
+#define IMAGE_POOL_H
+
+#include <mutex>
+#include <vector>
+#include "TGAImage.h"
+using namespace std;
+
+
+// Defining a class that keeps the pixel buffers of finished images so later images can reuse them
+// instead of allocating. Safe to use from several threads at once.
+class ImagePool {
+public:
+    // Gets an image of the given size, reusing a pooled buffer that is big enough if there is one.
+    // The pixel contents are left unspecified.
+    TGAImage acquire(int width, int height);
+
+    // Gives an image's buffer back to the pool. The image is left empty.
+    void release(TGAImage& image);
+
+    // Frees every pooled buffer.
+    void clear();
+
+    // Frees pooled buffers, largest first, until they hold at most maxBytes.
+    void trim(size_t maxBytes);
+
+    // Gets the number of bytes held by pooled buffers.
+    size_t getPooledBytes() const;
+
+private:
+    mutable mutex lock;
+    vector<TGAImage> images;
+};
+
+#endif // IMAGE_POOL_H
@@ -0,0 +1,373 @@
+#include "ImageServer.h"
+#include "LinearImage.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+using namespace std;
+
+namespace {
+
+// Converts a file time to nanoseconds.
+inline long long nanoseconds(const timespec& time) {
+    return static_cast<long long>(time.tv_sec) * 1000000000LL + time.tv_nsec;
+};
+
+}
+
+// Creates a server that will listen on the given socket path.
+ImageServer::ImageServer(const string& socketPath, int maxClients, size_t cacheLimitBytes, size_t poolLimitBytes)
+    : socketPath(socketPath), maxClients(max(1, maxClients)), activeClients(0), cacheLimitBytes(cacheLimitBytes),
+      cachedBytes(0), useCount(0), poolLimitBytes(poolLimitBytes) {
+};
+
+// Listens for clients until the process is stopped.
+bool ImageServer::run() {
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        cout << "Error: Socket path is too long: " << socketPath << endl;
+        return false;
+    }
+    strcpy(address.sun_path, socketPath.c_str());
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        cout << "Error: Failed to create the server socket." << endl;
+        return false;
+    }
+
+    // Removes a socket file left over from an earlier run before binding.
+    unlink(socketPath.c_str());
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(listener, 64) < 0) {
+        cout << "Error: Failed to listen on " << socketPath << ": " << strerror(errno) << endl;
+        close(listener);
+        return false;
+    }
+
+    cout << "Listening for jobs on " << socketPath << endl;
+
+    while (true) {
+        int client = accept(listener, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            cout << "Error: Failed to accept a client: " << strerror(errno) << endl;
+            break;
+        }
+
+        // Turns clients away rather than starting an unbounded number of threads.
+        if (activeClients.load() >= maxClients) {
+            const char busy[] = "ERROR server busy\n";
+            send(client, busy, sizeof(busy) - 1, MSG_NOSIGNAL);
+            close(client);
+            continue;
+        }
+
+        ++activeClients;
+        thread(&ImageServer::handleClient, this, client).detach();
+    }
+
+    close(listener);
+    unlink(socketPath.c_str());
+    return false;
+};
+
+// Reads job lines from a client and writes back the replies until it disconnects.
+void ImageServer::handleClient(int client) {
+    string pending;
+    char buffer[4096];
+
+    while (true) {
+        ssize_t received = recv(client, buffer, sizeof(buffer), 0);
+        if (received <= 0) {
+            break;
+        }
+        pending.append(buffer, received);
+
+        // Runs every complete line received so far.
+        size_t lineEnd;
+        while ((lineEnd = pending.find('\n')) != string::npos) {
+            // Counts as a running stage, so row parallelism shares the cores with the other clients' jobs.
+            ++concurrentStageCount();
+            string reply = runJob(pending.substr(0, lineEnd)) + "\n";
+            --concurrentStageCount();
+            pending.erase(0, lineEnd + 1);
+
+            // A burst of large jobs shouldn't pin its buffers for the rest of the server's life.
+            pool.trim(poolLimitBytes);
+
+            size_t sent = 0;
+            while (sent < reply.size()) {
+                ssize_t written = send(client, reply.data() + sent, reply.size() - sent, MSG_NOSIGNAL);
+                if (written <= 0) {
+                    close(client);
+                    --activeClients;
+                    return;
+                }
+                sent += written;
+            }
+        }
+    }
+
+    close(client);
+    --activeClients;
+};
+
+// Runs a single job line and returns the reply.
+string ImageServer::runJob(const string& job) {
+    istringstream words(job);
+    string operation;
+    words >> operation;
+
+    if (operation == "ping") {
+        return "OK";
+    }
+
+    TGAImage::BlendFunction blend = TGAImage::findBlend(operation);
+    if (blend != nullptr) {
+        string topFilename, bottomFilename, outputFilename;
+        if (!(words >> topFilename >> bottomFilename >> outputFilename)) {
+            return "ERROR usage: " + operation + " <topLayer> <bottomLayer> <output>";
+        }
+
+        shared_ptr<const TGAImage> top = loadCached(topFilename);
+        shared_ptr<const TGAImage> bottom = loadCached(bottomFilename);
+        if (!top || !bottom) {
+            return "ERROR failed to load the inputs";
+        }
+
+        TGAImage result = pool.acquire(top->getWidth(), top->getHeight());
+        if (!blend(top->view(), bottom->view(), result.view())) {
+            pool.release(result);
+            return "ERROR dimension mismatch";
+        }
+        return saveResult(result, outputFilename);
+    }
+
+    if (operation == "linear") {
+        // Folds the chain left to right at 16 bits in linear light, rounding to 8-bit sRGB once at the end.
+        vector<string> arguments;
+        string argument;
+        while (words >> argument) {
+            arguments.push_back(argument);
+        }
+        if (arguments.size() < 4 || arguments.size() % 2 != 0) {
+            return "ERROR usage: linear <image> <blend> <image> [<blend> <image>]... <output>";
+        }
+
+        shared_ptr<const TGAImage> first = loadCached(arguments[0]);
+        if (!first) {
+            return "ERROR failed to load " + arguments[0];
+        }
+        // The 16-bit buffers come from their own pool, so repeated jobs don't allocate them again.
+        LinearImage result = acquireLinear();
+        LinearImage layerLinear = acquireLinear();
+        LinearImage::fromSRGB(*first, result);
+
+        string error;
+        for (size_t i = 1; i + 2 < arguments.size() && error.empty(); i += 2) {
+            LinearImage::BlendFunction linearBlend = LinearImage::findBlend(arguments[i]);
+            if (linearBlend == nullptr) {
+                error = "ERROR unknown linear blend " + arguments[i];
+                continue;
+            }
+            shared_ptr<const TGAImage> layer = loadCached(arguments[i + 1]);
+            if (!layer) {
+                error = "ERROR failed to load " + arguments[i + 1];
+                continue;
+            }
+            LinearImage::fromSRGB(*layer, layerLinear);
+            if (!linearBlend(result, layerLinear, result)) {
+                error = "ERROR dimension mismatch";
+            }
+        }
+
+        TGAImage encoded;
+        if (error.empty()) {
+            encoded = pool.acquire(result.getWidth(), result.getHeight());
+            result.toSRGB(encoded.view());
+        }
+        releaseLinear(result);
+        releaseLinear(layerLinear);
+        if (!error.empty()) {
+            return error;
+        }
+        return saveResult(encoded, arguments.back());
+    }
+
+    if (operation == "add200green" || operation == "scale") {
+        float redScale = 1.0f, blueScale = 1.0f;
+        string inputFilename, outputFilename;
+        if ((operation == "scale" && !(words >> redScale >> blueScale)) || !(words >> inputFilename >> outputFilename)) {
+            return "ERROR usage: " + operation + (operation == "scale" ? " <redScale> <blueScale>" : "") + " <input> <output>";
+        }
+
+        shared_ptr<const TGAImage> input = loadCached(inputFilename);
+        if (!input) {
+            return "ERROR failed to load " + inputFilename;
+        }
+
+        TGAImage result = pool.acquire(input->getWidth(), input->getHeight());
+        if (operation == "scale") {
+            TGAImage::scaleChannels(input->view(), redScale, blueScale, result.view());
+        } else {
+            TGAImage::add200Green(input->view(), result.view());
+        }
+        return saveResult(result, outputFilename);
+    }
+
+    if (operation == "combine") {
+        string redFilename, greenFilename, blueFilename, outputFilename;
+        if (!(words >> redFilename >> greenFilename >> blueFilename >> outputFilename)) {
+            return "ERROR usage: combine <red> <green> <blue> <output>";
+        }
+
+        shared_ptr<const TGAImage> red = loadCached(redFilename);
+        shared_ptr<const TGAImage> green = loadCached(greenFilename);
+        shared_ptr<const TGAImage> blue = loadCached(blueFilename);
+        if (!red || !green || !blue) {
+            return "ERROR failed to load the inputs";
+        }
+
+        TGAImage result = TGAImage::combineChannels(*red, *green, *blue);
+        if (result.getWidth() == 0 || result.getHeight() == 0) {
+            return "ERROR dimension mismatch";
+        }
+        return saveResult(result, outputFilename);
+    }
+
+    if (operation == "flip" || operation == "pyramid") {
+        string inputFilename, outputFilename;
+        if (!(words >> inputFilename >> outputFilename)) {
+            return "ERROR usage: " + operation + " <input> <output>";
+        }
+
+        shared_ptr<const TGAImage> input = loadCached(inputFilename);
+        if (!input) {
+            return "ERROR failed to load " + inputFilename;
+        }
+
+        if (operation == "pyramid") {
+            return TGAImage::savePyramid(*input, outputFilename) ? "OK" : "ERROR failed to save the pyramid";
+        }
+        TGAImage result = TGAImage::flipImage180(*input);
+        return saveResult(result, outputFilename);
+    }
+
+    return "ERROR unknown operation: " + operation;
+};
+
+// Gets a decoded input, only reading the file again if it changed since it was cached.
+shared_ptr<const TGAImage> ImageServer::loadCached(const string& filename) {
+    struct stat info;
+    if (stat(filename.c_str(), &info) != 0) {
+        return shared_ptr<const TGAImage>();
+    }
+
+    {
+        lock_guard<mutex> guard(cacheLock);
+        map<string, CachedImage>::iterator cached = cache.find(filename);
+        if (cached != cache.end() && cached->second.modified == nanoseconds(info.st_mtim) &&
+            cached->second.changed == nanoseconds(info.st_ctim) && cached->second.inode == info.st_ino &&
+            cached->second.size == info.st_size) {
+            cached->second.lastUsed = ++useCount;
+            return cached->second.image;
+        }
+    }
+
+    // Decodes outside of the lock so other clients aren't held up. Two clients asking for the same
+    // new file may both decode it, the last one to finish is kept.
+    shared_ptr<TGAImage> image = make_shared<TGAImage>();
+    if (!image->loadImage(filename)) {
+        return shared_ptr<const TGAImage>();
+    }
+
+    CachedImage entry;
+    entry.modified = nanoseconds(info.st_mtim);
+    entry.changed = nanoseconds(info.st_ctim);
+    entry.inode = info.st_ino;
+    entry.size = info.st_size;
+    entry.bytes = image->getCapacity();
+    entry.image = image;
+
+    // An image bigger than the whole cache is used once and not kept.
+    if (entry.bytes > cacheLimitBytes) {
+        return image;
+    }
+
+    lock_guard<mutex> guard(cacheLock);
+    map<string, CachedImage>::iterator old = cache.find(filename);
+    if (old != cache.end()) {
+        cachedBytes -= old->second.bytes;
+        cache.erase(old);
+    }
+
+    // Drops the least recently used inputs until the new one fits. Jobs still using a dropped
+    // image keep it alive through their own shared_ptr.
+    while (cachedBytes + entry.bytes > cacheLimitBytes && !cache.empty()) {
+        map<string, CachedImage>::iterator oldest = cache.begin();
+        for (map<string, CachedImage>::iterator i = cache.begin(); i != cache.end(); ++i) {
+            if (i->second.lastUsed < oldest->second.lastUsed) {
+                oldest = i;
+            }
+        }
+        cachedBytes -= oldest->second.bytes;
+        cache.erase(oldest);
+    }
+
+    entry.lastUsed = ++useCount;
+    cachedBytes += entry.bytes;
+    cache[filename] = entry;
+    return image;
+};
+
+// Gets a 16-bit image whose buffer can be reused, or an empty one if none are pooled.
+LinearImage ImageServer::acquireLinear() {
+    lock_guard<mutex> guard(linearPoolLock);
+    if (linearPool.empty()) {
+        return LinearImage();
+    }
+    LinearImage image = move(linearPool.back());
+    linearPool.pop_back();
+    return image;
+};
+
+// Gives a 16-bit image's buffer back to the pool, freeing the largest pooled buffers past poolLimitBytes.
+void ImageServer::releaseLinear(LinearImage& image) {
+    lock_guard<mutex> guard(linearPoolLock);
+    linearPool.push_back(move(image));
+    image = LinearImage();
+
+    size_t bytes = 0;
+    for (size_t i = 0; i < linearPool.size(); ++i) {
+        bytes += linearPool[i].getCapacity();
+    }
+    while (bytes > poolLimitBytes) {
+        size_t largest = 0;
+        for (size_t i = 1; i < linearPool.size(); ++i) {
+            if (linearPool[i].getCapacity() > linearPool[largest].getCapacity()) {
+                largest = i;
+            }
+        }
+        bytes -= linearPool[largest].getCapacity();
+        linearPool[largest] = move(linearPool.back());
+        linearPool.pop_back();
+    }
+};
+
+// Saves a result and hands its buffer back to the pool.
+string ImageServer::saveResult(TGAImage& result, const string& filename) {
+    bool saved = result.saveImage(filename);
+    pool.release(result);
+    return saved ? "OK" : "ERROR failed to save " + filename;
+};
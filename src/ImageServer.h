@@ -0,0 +1,95 @@
+#ifndef IMAGE_SERVER_H
+#define IMAGE_SERVER_H
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ImagePool.h"
+#include "LinearImage.h"
+#include "TGAImage.h"
+using namespace std;
+
+
+// Defining a class for a long-running server that takes image jobs over a local Unix domain socket.
+// Decoded inputs and result buffers stay warm between jobs. Every client gets its own thread, up to
+// maxClients at once; clients past that are told the server is busy and disconnected. Decoded inputs
+// are kept up to cacheLimitBytes, dropping the least recently used first, and the 8-bit and 16-bit buffer
+// pools are each trimmed back to poolLimitBytes after every job. Jobs running at the same time split the
+// cores between them the way pipeline stages do, rather than each one starting a thread per core.
+//
+// Clients send one job per line and get one reply line back, "OK" or "ERROR <message>":
+//   <blend> <topLayer> <bottomLayer> <output>   blend is multiply, subtract, screen, overlay, darken,
+//                                               lighten, difference, colordodge, colorburn, softlight,
+//                                               hardlight or add
+//   linear <image> <blend> <image> [<blend> <image>]... <output>
+//                                               blends in 16-bit linear light, each step taking the result
+//                                               so far as the top layer; blend is multiply, subtract, screen,
+//                                               overlay, darken, lighten, difference or add
+//   add200green <input> <output>
+//   scale <redScale> <blueScale> <input> <output>
+//   combine <red> <green> <blue> <output>
+//   flip <input> <output>
+//   pyramid <input> <baseFilename>
+//   ping
+// Filenames ending in .qoi are read and written as QOI, anything else as TGA.
+class ImageServer {
+public:
+    // Creates a server that will listen on the given socket path.
+    explicit ImageServer(const string& socketPath, int maxClients = 64, size_t cacheLimitBytes = 512 << 20,
+                         size_t poolLimitBytes = 256 << 20);
+
+    // Listens for clients until the process is stopped. Returns false if the socket can't be set up.
+    bool run();
+
+    // Runs a single job line and returns the reply, without the trailing newline.
+    string runJob(const string& job);
+
+private:
+    // Defining a structure to hold a decoded input, what the file looked like when it was decoded, and
+    // when a job last used it. Times are in nanoseconds, so a file rewritten within a second is still seen
+    // as changed, and the inode changes when a file is replaced by renaming another over it.
+    struct CachedImage {
+        long long modified;
+        long long changed;
+        unsigned long long inode;
+        long long size;
+        size_t bytes;
+        unsigned long long lastUsed;
+        shared_ptr<const TGAImage> image;
+    };
+
+    string socketPath;
+    int maxClients;
+    atomic<int> activeClients;
+
+    mutex cacheLock;
+    map<string, CachedImage> cache;
+    size_t cacheLimitBytes;
+    size_t cachedBytes;
+    unsigned long long useCount;
+
+    ImagePool pool;
+    size_t poolLimitBytes;
+
+    // Buffers of the 16-bit images linear jobs work in, two per running job at most.
+    mutex linearPoolLock;
+    vector<LinearImage> linearPool;
+
+    // Gets a decoded input, only reading the file again if it changed since it was cached.
+    shared_ptr<const TGAImage> loadCached(const string& filename);
+
+    // Gets a 16-bit image to decode into, reusing a pooled buffer if there is one, and gives it back.
+    LinearImage acquireLinear();
+    void releaseLinear(LinearImage& image);
+
+    // Saves a result and hands its buffer back to the pool.
+    string saveResult(TGAImage& result, const string& filename);
+
+    // Reads job lines from a client and writes back the replies until it disconnects.
+    void handleClient(int client);
+};
+
+#endif // IMAGE_SERVER_H
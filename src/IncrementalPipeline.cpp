@@ -0,0 +1,181 @@
+#include "IncrementalPipeline.h"
+#include <iostream>
+using namespace std;
+
+// Adds a source image owned by the caller.
+int IncrementalPipeline::addSource(TGAImage* image) {
+    Node node;
+    node.type = SourceNode;
+    node.source = image;
+    node.blend = nullptr;
+    node.computed = false;
+    node.seenGeneration = 0;
+    nodes.push_back(node);
+    return static_cast<int>(nodes.size()) - 1;
+};
+
+// Adds a blend of two earlier nodes.
+int IncrementalPipeline::addBlend(const string& blendName, int topLayer, int bottomLayer) {
+    TGAImage::BlendFunction blend = TGAImage::findBlend(blendName);
+    int nodeCount = static_cast<int>(nodes.size());
+    if (blend == nullptr || topLayer < 0 || topLayer >= nodeCount || bottomLayer < 0 || bottomLayer >= nodeCount) {
+        cout << "Error: Invalid blend node: " << blendName << endl;
+        return -1;
+    }
+
+    Node node;
+    node.type = BlendNode;
+    node.inputs.push_back(topLayer);
+    node.inputs.push_back(bottomLayer);
+    node.source = nullptr;
+    node.blend = blend;
+    node.computed = false;
+    nodes.push_back(node);
+    return nodeCount;
+};
+
+// Adds a per-pixel adjustment of an earlier node.
+int IncrementalPipeline::addAdjust(int input, AdjustFunction adjust) {
+    int nodeCount = static_cast<int>(nodes.size());
+    if (input < 0 || input >= nodeCount) {
+        cout << "Error: Invalid adjust node input." << endl;
+        return -1;
+    }
+
+    Node node;
+    node.type = AdjustNode;
+    node.inputs.push_back(input);
+    node.source = nullptr;
+    node.blend = nullptr;
+    node.adjust = adjust;
+    node.computed = false;
+    nodes.push_back(node);
+    return nodeCount;
+};
+
+// Adds a 180 degree flip of an earlier node.
+int IncrementalPipeline::addFlip(int input) {
+    int nodeCount = static_cast<int>(nodes.size());
+    if (input < 0 || input >= nodeCount) {
+        cout << "Error: Invalid flip node input." << endl;
+        return -1;
+    }
+
+    Node node;
+    node.type = FlipNode;
+    node.inputs.push_back(input);
+    node.source = nullptr;
+    node.blend = nullptr;
+    node.computed = false;
+    nodes.push_back(node);
+    return nodeCount;
+};
+
+// Brings every result up to date, recomputing only the rectangles that depend on changed pixels.
+bool IncrementalPipeline::evaluate() {
+    bool success = true;
+
+    // Nodes only read earlier nodes, so one pass in order sees every input already up to date.
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        Node& node = nodes[i];
+        node.updatedRects = rectsToUpdate(node);
+
+        if (node.type == SourceNode) {
+            continue;
+        }
+
+        for (size_t r = 0; r < node.updatedRects.size(); ++r) {
+            if (!updateRect(node, node.updatedRects[r])) {
+                // Forget the result so the next evaluate() starts over.
+                node.computed = false;
+                node.updatedRects.assign(1, TGARect { 0, 0, node.output.getWidth(), node.output.getHeight() });
+                success = false;
+                break;
+            }
+        }
+    }
+
+    return success;
+};
+
+// Gets the current result of a node.
+const TGAImage& IncrementalPipeline::getOutput(int node) const {
+    return resultOf(node);
+};
+
+// Gets the rectangles of a node's result that the last evaluate() recomputed.
+const vector<TGARect>& IncrementalPipeline::getUpdatedRects(int node) const {
+    return nodes[node].updatedRects;
+};
+
+// Gets the image a node's result lives in.
+const TGAImage& IncrementalPipeline::resultOf(int node) const {
+    return nodes[node].type == SourceNode ? *nodes[node].source : nodes[node].output;
+};
+
+// Works out which rectangles of a node need recomputing.
+vector<TGARect> IncrementalPipeline::rectsToUpdate(Node& node) {
+    if (node.type == SourceNode) {
+        // A source is new to the pipeline the first time it is seen, after that only the edits made since
+        // the last evaluate() count. If the source can't remember all of them, everything is redone.
+        vector<TGARect> rects;
+        bool remembered = node.computed && node.source->getDirtyRectsSince(node.seenGeneration, rects);
+        node.computed = true;
+        node.seenGeneration = node.source->getDirtyGeneration();
+        if (!remembered) {
+            rects.assign(1, TGARect { 0, 0, node.source->getWidth(), node.source->getHeight() });
+        }
+        return rects;
+    }
+
+    // Without a result of the right size there is nothing to reuse, so compute all of it.
+    const TGAImage& firstInput = resultOf(node.inputs[0]);
+    int width = firstInput.getWidth();
+    int height = firstInput.getHeight();
+    if (!node.computed || node.output.getWidth() != width || node.output.getHeight() != height) {
+        node.output.resize(width, height);
+        node.computed = true;
+        return vector<TGARect>(1, TGARect { 0, 0, width, height });
+    }
+
+    // Otherwise every input rectangle that changed maps to the same rectangle of the result,
+    // except for flips, which mirror it to the other corner.
+    vector<TGARect> rects;
+    for (size_t i = 0; i < node.inputs.size(); ++i) {
+        const vector<TGARect>& inputRects = nodes[node.inputs[i]].updatedRects;
+        for (size_t r = 0; r < inputRects.size(); ++r) {
+            TGARect rect = inputRects[r];
+            if (node.type == FlipNode) {
+                rect.x = width - rect.x - rect.width;
+                rect.y = height - rect.y - rect.height;
+            }
+            TGAImage::addRect(rects, rect);
+        }
+    }
+    return rects;
+};
+
+// Recomputes one rectangle of a node's result from its inputs.
+bool IncrementalPipeline::updateRect(Node& node, const TGARect& rect) {
+    TGAImageView result = node.output.view(rect.x, rect.y, rect.width, rect.height);
+
+    if (node.type == BlendNode) {
+        TGAConstImageView top = resultOf(node.inputs[0]).view(rect.x, rect.y, rect.width, rect.height);
+        TGAConstImageView bottom = resultOf(node.inputs[1]).view(rect.x, rect.y, rect.width, rect.height);
+        if (top.data == nullptr || bottom.data == nullptr) {
+            cout << "Error: Dimension mismatch between the two images." << endl;
+            return false;
+        }
+        return node.blend(top, bottom, result);
+    }
+
+    if (node.type == AdjustNode) {
+        return node.adjust(resultOf(node.inputs[0]).view(rect.x, rect.y, rect.width, rect.height), result);
+    }
+
+    // A flip reads the mirrored rectangle of its input.
+    const TGAImage& input = resultOf(node.inputs[0]);
+    TGAConstImageView source = input.view(input.getWidth() - rect.x - rect.width,
+                                          input.getHeight() - rect.y - rect.height, rect.width, rect.height);
+    return TGAImage::flipImage180(source, result);
+};
@@ -0,0 +1,78 @@
+#ifndef INCREMENTAL_PIPELINE_H
+#define INCREMENTAL_PIPELINE_H
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "TGAImage.h"
+using namespace std;
+
+
+// Defining a class for a pipeline that keeps its results between evaluations and only recomputes
+// the parts of them that depend on pixels which changed. Sources are images owned by the caller;
+// after editing one (loadTGA, assigning another image to it, or writing pixels and calling markDirty),
+// evaluate() recomputes just the dirty rectangles of every downstream result instead of the whole frame.
+// Each pipeline remembers which edits of a source it has seen, so several pipelines can share a source.
+class IncrementalPipeline {
+public:
+    // Per-pixel operation that reads one view and writes a view of the same size.
+    typedef function<bool(const TGAConstImageView& image, const TGAImageView& result)> AdjustFunction;
+
+    // Adds a source image. The image must outlive the pipeline. Returns the node's id.
+    int addSource(TGAImage* image);
+
+    // Adds a blend of two earlier nodes, by blend name (see TGAImage::findBlend). Returns the node's id,
+    // or -1 if the name or inputs are invalid.
+    int addBlend(const string& blendName, int topLayer, int bottomLayer);
+
+    // Adds a per-pixel adjustment of an earlier node, such as TGAImage::add200Green. Returns the node's id.
+    int addAdjust(int input, AdjustFunction adjust);
+
+    // Adds a 180 degree flip of an earlier node. Returns the node's id.
+    int addFlip(int input);
+
+    // Brings every result up to date. The sources' own dirty rectangles are left alone.
+    // Returns false if a blend failed because of a dimension mismatch.
+    bool evaluate();
+
+    // Gets the current result of a node.
+    const TGAImage& getOutput(int node) const;
+
+    // Gets the rectangles of a node's result that the last evaluate() recomputed.
+    const vector<TGARect>& getUpdatedRects(int node) const;
+
+private:
+    // Defining the kinds of nodes a pipeline can hold.
+    enum NodeType {
+        SourceNode,
+        BlendNode,
+        AdjustNode,
+        FlipNode
+    };
+
+    // Defining a structure to hold one node and its cached result.
+    struct Node {
+        NodeType type;
+        vector<int> inputs;
+        TGAImage* source;
+        TGAImage::BlendFunction blend;
+        AdjustFunction adjust;
+        TGAImage output;
+        bool computed;
+        unsigned long long seenGeneration; // latest edit of a source this pipeline has seen
+        vector<TGARect> updatedRects;
+    };
+
+    vector<Node> nodes;
+
+    // Gets the image a node's result lives in, the caller's image for sources.
+    const TGAImage& resultOf(int node) const;
+
+    // Works out which rectangles of a node need recomputing, the whole image if it has no valid result yet.
+    vector<TGARect> rectsToUpdate(Node& node);
+
+    // Recomputes one rectangle of a node's result from its inputs.
+    bool updateRect(Node& node, const TGARect& rect);
+};
+
+#endif // INCREMENTAL_PIPELINE_H
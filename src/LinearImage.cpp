@@ -0,0 +1,302 @@
+#include "LinearImage.h"
+#include "Parallel.h"
+#include <cmath>
+#include <iostream>
+using namespace std;
+
+namespace {
+
+// sRGB to linear for every 8-bit value, scaled to 65535.
+const unsigned short* decodeTable() {
+    static const vector<unsigned short> table = []() {
+        vector<unsigned short> values(256);
+        for (int i = 0; i < 256; ++i) {
+            double srgb = i / 255.0;
+            double linear = srgb <= 0.04045 ? srgb / 12.92 : pow((srgb + 0.055) / 1.055, 2.4);
+            values[i] = static_cast<unsigned short>(floor(linear * 65535.0 + 0.5));
+        }
+        return values;
+    }();
+    return table.data();
+};
+
+// Linear to sRGB for every 16-bit value, rounded to 8 bits. 64 KB, so it stays in cache while encoding.
+const unsigned char* encodeTable() {
+    static const vector<unsigned char> table = []() {
+        vector<unsigned char> values(65536);
+        for (int i = 0; i < 65536; ++i) {
+            double linear = i / 65535.0;
+            double srgb = linear <= 0.0031308 ? linear * 12.92 : 1.055 * pow(linear, 1.0 / 2.4) - 0.055;
+            values[i] = static_cast<unsigned char>(floor(srgb * 255.0 + 0.5));
+        }
+        return values;
+    }();
+    return table.data();
+};
+
+// Divides by 65535, rounding to nearest. Exact for every product of two 16-bit values.
+inline unsigned int div65535(unsigned int x) {
+    x += 32768;
+    return (x + (x >> 16)) >> 16;
+};
+
+// C = A * B
+struct LinearMultiplyOp {
+    static inline unsigned short apply(unsigned int top, unsigned int bottom) {
+        return static_cast<unsigned short>(div65535(top * bottom));
+    }
+};
+
+// C = B - A, clamped at 0.
+struct LinearSubtractOp {
+    static inline unsigned short apply(unsigned int top, unsigned int bottom) {
+        return static_cast<unsigned short>(bottom >= top ? bottom - top : 0);
+    }
+};
+
+// C = 1 - (1 - A) * (1 - B)
+struct LinearScreenOp {
+    static inline unsigned short apply(unsigned int top, unsigned int bottom) {
+        return static_cast<unsigned short>(65535 - div65535((65535 - top) * (65535 - bottom)));
+    }
+};
+
+// Overlay keyed on the first layer: multiply the dark half, screen the light half.
+struct LinearOverlayOp {
+    static inline unsigned short apply(unsigned int background, unsigned int foreground) {
+        if (background < 32768) {
+            return static_cast<unsigned short>(div65535(2 * background * foreground)); // C = 2 * A * B
+        }
+        return static_cast<unsigned short>(65535 - div65535(2 * (65535 - background) * (65535 - foreground))); // C = 1 - 2 * (1 - A) * (1 - B)
+    }
+};
+
+// C = min(A, B)
+struct LinearDarkenOp {
+    static inline unsigned short apply(unsigned int top, unsigned int bottom) {
+        return static_cast<unsigned short>(top < bottom ? top : bottom);
+    }
+};
+
+// C = max(A, B)
+struct LinearLightenOp {
+    static inline unsigned short apply(unsigned int top, unsigned int bottom) {
+        return static_cast<unsigned short>(top > bottom ? top : bottom);
+    }
+};
+
+// C = |A - B|
+struct LinearDifferenceOp {
+    static inline unsigned short apply(unsigned int top, unsigned int bottom) {
+        return static_cast<unsigned short>(top > bottom ? top - bottom : bottom - top);
+    }
+};
+
+// C = min(A + B, 1)
+struct LinearAddOp {
+    static inline unsigned short apply(unsigned int top, unsigned int bottom) {
+        unsigned int value = top + bottom;
+        return static_cast<unsigned short>(value > 65535 ? 65535 : value);
+    }
+};
+
+}
+
+// Default constructor, an empty image.
+LinearImage::LinearImage() : width(0), height(0) {
+};
+
+// Constructs a black width x height image.
+LinearImage::LinearImage(int width, int height)
+    : width(width), height(height), pixels(static_cast<size_t>(width) * height * 3) {
+};
+
+int LinearImage::getWidth() const {
+    return width;
+};
+
+int LinearImage::getHeight() const {
+    return height;
+};
+
+// Gets the number of bytes the image can hold without reallocating.
+size_t LinearImage::getCapacity() const {
+    return pixels.capacity() * sizeof(unsigned short);
+};
+
+unsigned short* LinearImage::getData() {
+    return pixels.data();
+};
+
+const unsigned short* LinearImage::getData() const {
+    return pixels.data();
+};
+
+// Decodes an sRGB image into linear light.
+LinearImage LinearImage::fromSRGB(const TGAImage& image) {
+    LinearImage resultImage;
+    fromSRGB(image, resultImage);
+    return resultImage;
+};
+
+// Decodes into an existing image with one table lookup per channel.
+void LinearImage::fromSRGB(const TGAImage& image, LinearImage& result) {
+    result.width = image.getWidth();
+    result.height = image.getHeight();
+    result.pixels.resize(static_cast<size_t>(result.width) * result.height * 3);
+
+    const unsigned short* table = decodeTable();
+    TGAConstImageView source = image.view();
+    unsigned short* destination = result.pixels.data();
+    int rowValues = result.width * 3;
+
+    parallelRows(result.height, [=](int firstRow, int endRow) {
+        for (int y = firstRow; y < endRow; ++y) {
+            const unsigned char* in = source.data + y * source.stride;
+            unsigned short* out = destination + static_cast<size_t>(y) * rowValues;
+            for (int x = 0; x < rowValues; ++x) {
+                out[x] = table[in[x]];
+            }
+        }
+    });
+};
+
+// Encodes the image back to sRGB.
+TGAImage LinearImage::toSRGB() const {
+    TGAImage resultImage(width, height);
+    toSRGB(resultImage.view());
+    return resultImage;
+};
+
+// Encodes into a view with one table lookup per channel.
+bool LinearImage::toSRGB(const TGAImageView& result) const {
+    if (result.width != width || result.height != height) {
+        cout << "Error: Dimension mismatch between the two images." << endl;
+        return false;
+    }
+
+    const unsigned char* table = encodeTable();
+    const unsigned short* source = pixels.data();
+    int rowValues = width * 3;
+
+    parallelRows(height, [=](int firstRow, int endRow) {
+        for (int y = firstRow; y < endRow; ++y) {
+            const unsigned short* in = source + static_cast<size_t>(y) * rowValues;
+            unsigned char* out = result.data + y * result.stride;
+            for (int x = 0; x < rowValues; ++x) {
+                out[x] = table[in[x]];
+            }
+        }
+    });
+    return true;
+};
+
+// Applies a per-channel blend functor to every value of two equally sized images.
+template <typename BlendOp>
+bool LinearImage::blendLinear(const LinearImage& first, const LinearImage& second, LinearImage& result) {
+    if (first.width != second.width || first.height != second.height) {
+        cout << "Error: Dimension mismatch between the two images." << endl;
+        return false;
+    }
+
+    // Resizing is a no-op when the result is one of the inputs.
+    result.width = first.width;
+    result.height = first.height;
+    result.pixels.resize(first.pixels.size());
+
+    const unsigned short* a = first.pixels.data();
+    const unsigned short* b = second.pixels.data();
+    unsigned short* c = result.pixels.data();
+    size_t rowValues = static_cast<size_t>(first.width) * 3;
+
+    parallelRows(first.height, [=](int firstRow, int endRow) {
+        for (size_t i = firstRow * rowValues; i < endRow * rowValues; ++i) {
+            c[i] = BlendOp::apply(a[i], b[i]);
+        }
+    });
+    return true;
+};
+
+bool LinearImage::multiplyImages(const LinearImage& topLayer, const LinearImage& bottomLayer, LinearImage& result) {
+    return blendLinear<LinearMultiplyOp>(topLayer, bottomLayer, result);
+};
+
+bool LinearImage::subtractImages(const LinearImage& topLayer, const LinearImage& bottomLayer, LinearImage& result) {
+    return blendLinear<LinearSubtractOp>(topLayer, bottomLayer, result);
+};
+
+bool LinearImage::screenImages(const LinearImage& topLayer, const LinearImage& bottomLayer, LinearImage& result) {
+    return blendLinear<LinearScreenOp>(topLayer, bottomLayer, result);
+};
+
+bool LinearImage::overlayImages(const LinearImage& background, const LinearImage& foreground, LinearImage& result) {
+    return blendLinear<LinearOverlayOp>(background, foreground, result);
+};
+
+bool LinearImage::darkenImages(const LinearImage& topLayer, const LinearImage& bottomLayer, LinearImage& result) {
+    return blendLinear<LinearDarkenOp>(topLayer, bottomLayer, result);
+};
+
+bool LinearImage::lightenImages(const LinearImage& topLayer, const LinearImage& bottomLayer, LinearImage& result) {
+    return blendLinear<LinearLightenOp>(topLayer, bottomLayer, result);
+};
+
+bool LinearImage::differenceImages(const LinearImage& topLayer, const LinearImage& bottomLayer, LinearImage& result) {
+    return blendLinear<LinearDifferenceOp>(topLayer, bottomLayer, result);
+};
+
+bool LinearImage::addImages(const LinearImage& topLayer, const LinearImage& bottomLayer, LinearImage& result) {
+    return blendLinear<LinearAddOp>(topLayer, bottomLayer, result);
+};
+
+// Scales the channels of an image with 16.16 fixed-point factors.
+void LinearImage::scaleChannels(const LinearImage& image, float redScale, float greenScale, float blueScale,
+                                LinearImage& result) {
+    result.width = image.width;
+    result.height = image.height;
+    result.pixels.resize(image.pixels.size());
+
+    // Factors in BGR order, clamped so value * factor fits in 64 bits with room to spare.
+    unsigned long long factors[3];
+    float scales[3] = { blueScale, greenScale, redScale };
+    for (int i = 0; i < 3; ++i) {
+        factors[i] = static_cast<unsigned long long>(min(65536.0f, max(0.0f, scales[i])) * 65536.0f + 0.5f);
+    }
+
+    const unsigned short* source = image.pixels.data();
+    unsigned short* destination = result.pixels.data();
+    size_t rowValues = static_cast<size_t>(image.width) * 3;
+
+    parallelRows(image.height, [=](int firstRow, int endRow) {
+        for (size_t i = firstRow * rowValues; i < endRow * rowValues; i += 3) {
+            for (int channel = 0; channel < 3; ++channel) {
+                unsigned long long value = (source[i + channel] * factors[channel] + 32768) >> 16;
+                destination[i + channel] = static_cast<unsigned short>(value > 65535 ? 65535 : value);
+            }
+        }
+    });
+};
+
+// Looks up a blend by its short name.
+LinearImage::BlendFunction LinearImage::findBlend(const string& name) {
+    static const struct {
+        const char* name;
+        BlendFunction function;
+    } blends[] = {
+        { "multiply", &LinearImage::multiplyImages },
+        { "subtract", &LinearImage::subtractImages },
+        { "screen", &LinearImage::screenImages },
+        { "overlay", &LinearImage::overlayImages },
+        { "darken", &LinearImage::darkenImages },
+        { "lighten", &LinearImage::lightenImages },
+        { "difference", &LinearImage::differenceImages },
+        { "add", &LinearImage::addImages },
+    };
+
+    for (size_t i = 0; i < sizeof(blends) / sizeof(blends[0]); ++i) {
+        if (name == blends[i].name) {
+            return blends[i].function;
+        }
+    }
+    return nullptr;
+};
@@ -0,0 +1,79 @@
+#ifndef LINEAR_IMAGE_H
+#define LINEAR_IMAGE_H
+
+#include <string>
+#include <vector>
+#include "TGAImage.h"
+using namespace std;
+
+
+// Defining a class to hold an image in linear light with 16 bits per channel, for blending without the
+// darkening and banding of working on gamma-encoded 8-bit values. Pixels are in BGR order with the first
+// row at the bottom, like TGAImage, and 65535 is full intensity.
+//
+// Converting from sRGB goes through a 256-entry table and back through a 65536-entry one, so the
+// conversions cost one lookup per channel. An 8-bit image converted in and straight back out is unchanged.
+// Chains of operations stay at 16 bits and only round to 8 bits once, in toSRGB.
+class LinearImage {
+public:
+    // Blend operations that read two images and write into a third, which may be one of the inputs.
+    typedef bool (*BlendFunction)(const LinearImage& topLayer, const LinearImage& bottomLayer, LinearImage& result);
+
+    // Default constructor, an empty image.
+    LinearImage();
+
+    // Constructs a black width x height image.
+    LinearImage(int width, int height);
+
+    int getWidth() const;
+    int getHeight() const;
+
+    // Gets the number of bytes the image can hold without reallocating.
+    size_t getCapacity() const;
+
+    // Gets the channel values, width * height * 3 of them.
+    unsigned short* getData();
+    const unsigned short* getData() const;
+
+    // Decodes an sRGB image into linear light.
+    static LinearImage fromSRGB(const TGAImage& image);
+
+    // Decodes into an existing image, reusing its buffer when it's big enough.
+    static void fromSRGB(const TGAImage& image, LinearImage& result);
+
+    // Encodes the image back to sRGB, rounding to the nearest 8-bit value.
+    TGAImage toSRGB() const;
+
+    // Encodes into a view of the same size, such as a pooled image. Returns false on a dimension mismatch.
+    bool toSRGB(const TGAImageView& result) const;
+
+    // Blends in linear light, with the same formulas as the TGAImage blends of the same name.
+    // They return false on a dimension mismatch, and size the result to match otherwise.
+    static bool multiplyImages(const LinearImage& topLayer, const LinearImage& bottomLayer, LinearImage& result);
+    static bool subtractImages(const LinearImage& topLayer, const LinearImage& bottomLayer, LinearImage& result);
+    static bool screenImages(const LinearImage& topLayer, const LinearImage& bottomLayer, LinearImage& result);
+    static bool overlayImages(const LinearImage& background, const LinearImage& foreground, LinearImage& result);
+    static bool darkenImages(const LinearImage& topLayer, const LinearImage& bottomLayer, LinearImage& result);
+    static bool lightenImages(const LinearImage& topLayer, const LinearImage& bottomLayer, LinearImage& result);
+    static bool differenceImages(const LinearImage& topLayer, const LinearImage& bottomLayer, LinearImage& result);
+    static bool addImages(const LinearImage& topLayer, const LinearImage& bottomLayer, LinearImage& result);
+
+    // Scales the channels of an image, clamping at full intensity. The result may be the image itself.
+    static void scaleChannels(const LinearImage& image, float redScale, float greenScale, float blueScale,
+                              LinearImage& result);
+
+    // Looks up a blend by its short name ("multiply", "subtract", "screen", "overlay", "darken", "lighten",
+    // "difference" or "add"). Returns nullptr for an unknown name.
+    static BlendFunction findBlend(const string& name);
+
+private:
+    int width;
+    int height;
+    vector<unsigned short> pixels;
+
+    // Applies a per-channel blend functor to every value of two equally sized images.
+    template <typename BlendOp>
+    static bool blendLinear(const LinearImage& first, const LinearImage& second, LinearImage& result);
+};
+
+#endif // LINEAR_IMAGE_H
@@ -0,0 +1,45 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+using namespace std;
+
+
+// Number of pipeline stages (or server jobs) currently running side by side. Row-level parallelism inside
+// a stage splits the machine's threads between them instead of every stage starting a thread per core.
+inline atomic<int>& concurrentStageCount() {
+    static atomic<int> count(0);
+    return count;
+};
+
+// Splits the rows [0, rowCount) into contiguous bands and calls body(firstRow, endRow) for each band
+// on its own thread. Small images are processed on the calling thread to avoid thread startup cost.
+template <typename Body>
+void parallelRows(int rowCount, Body body, int minRowsPerBand = 32) {
+    // Works out how many threads are worth starting for this many rows.
+    int threadCount = static_cast<int>(thread::hardware_concurrency()) / max(1, concurrentStageCount().load());
+    threadCount = max(1, min(threadCount, rowCount / max(1, minRowsPerBand)));
+
+    if (threadCount <= 1) {
+        body(0, rowCount);
+        return;
+    }
+
+    // Hands each worker an equal share of rows, the calling thread takes the last band.
+    int rowsPerBand = (rowCount + threadCount - 1) / threadCount;
+    vector<thread> workers;
+    workers.reserve(threadCount - 1);
+    for (int firstRow = 0; firstRow + rowsPerBand < rowCount; firstRow += rowsPerBand) {
+        workers.push_back(thread(body, firstRow, firstRow + rowsPerBand));
+    }
+    body(static_cast<int>(workers.size()) * rowsPerBand, rowCount);
+
+    for (size_t i = 0; i < workers.size(); ++i) {
+        workers[i].join();
+    }
+};
+
+#endif // PARALLEL_H
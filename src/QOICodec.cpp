@@ -0,0 +1,233 @@
+#include "QOICodec.h"
+#include <cstring>
+using namespace std;
+
+namespace {
+
+// QOI chunk tags.
+const unsigned char QOI_OP_INDEX = 0x00; // 00xxxxxx
+const unsigned char QOI_OP_DIFF = 0x40;  // 01xxxxxx
+const unsigned char QOI_OP_LUMA = 0x80;  // 10xxxxxx
+const unsigned char QOI_OP_RUN = 0xc0;   // 11xxxxxx
+const unsigned char QOI_OP_RGB = 0xfe;
+const unsigned char QOI_OP_RGBA = 0xff;
+const unsigned char QOI_MASK_2 = 0xc0;
+
+// Seven zero bytes and a one mark the end of the stream.
+const unsigned char QOI_END_MARKER[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+
+// Position of a color in the running index of recently seen colors.
+inline int colorHash(const unsigned char* rgba) {
+    return (rgba[0] * 3 + rgba[1] * 5 + rgba[2] * 7 + rgba[3] * 11) % 64;
+};
+
+// Writes a 32-bit big-endian value.
+inline void writeBigEndian(unsigned char* out, unsigned int value) {
+    out[0] = static_cast<unsigned char>(value >> 24);
+    out[1] = static_cast<unsigned char>(value >> 16);
+    out[2] = static_cast<unsigned char>(value >> 8);
+    out[3] = static_cast<unsigned char>(value);
+};
+
+// Reads a 32-bit big-endian value.
+inline unsigned int readBigEndian(const unsigned char* in) {
+    return (static_cast<unsigned int>(in[0]) << 24) | (static_cast<unsigned int>(in[1]) << 16) |
+           (static_cast<unsigned int>(in[2]) << 8) | static_cast<unsigned int>(in[3]);
+};
+
+}
+
+// Writes the QOI header for a width x height RGB image to the stream.
+QOIEncoder::QOIEncoder(ostream& stream, int width, int height)
+    : stream(stream), width(width), height(height), rowsWritten(0), run(0) {
+
+    previous[0] = 0;
+    previous[1] = 0;
+    previous[2] = 0;
+    previous[3] = 255;
+    memset(index, 0, sizeof(index));
+
+    // "qoif", width, height, 3 channels, sRGB with linear alpha.
+    unsigned char header[14] = { 'q', 'o', 'i', 'f' };
+    writeBigEndian(header + 4, width);
+    writeBigEndian(header + 8, height);
+    header[12] = 3;
+    header[13] = 0;
+    stream.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+    // Worst case is four bytes per pixel (QOI_OP_RGB).
+    buffer.reserve(width * 4 + 1);
+};
+
+// Encodes the next row of width BGR pixels.
+bool QOIEncoder::writeRow(const unsigned char* row) {
+    if (rowsWritten >= height) {
+        return false;
+    }
+    ++rowsWritten;
+    bool lastRow = rowsWritten == height;
+    buffer.clear();
+
+    for (int x = 0; x < width; ++x) {
+        unsigned char pixel[4] = { row[x * 3 + 2], row[x * 3 + 1], row[x * 3], 255 };
+
+        // Repeats of the previous pixel extend the current run, up to 62 pixels per chunk.
+        if (pixel[0] == previous[0] && pixel[1] == previous[1] && pixel[2] == previous[2]) {
+            ++run;
+            if (run == 62 || (lastRow && x == width - 1)) {
+                buffer.push_back(QOI_OP_RUN | (run - 1));
+                run = 0;
+            }
+            continue;
+        }
+
+        if (run > 0) {
+            buffer.push_back(QOI_OP_RUN | (run - 1));
+            run = 0;
+        }
+
+        int hash = colorHash(pixel);
+        if (memcmp(index[hash], pixel, 4) == 0) {
+            // Seen recently, refer to it by its index position.
+            buffer.push_back(QOI_OP_INDEX | hash);
+        } else {
+            memcpy(index[hash], pixel, 4);
+
+            // Small changes from the previous pixel fit in one or two bytes, otherwise store it whole.
+            signed char dr = static_cast<signed char>(pixel[0] - previous[0]);
+            signed char dg = static_cast<signed char>(pixel[1] - previous[1]);
+            signed char db = static_cast<signed char>(pixel[2] - previous[2]);
+            signed char drDg = static_cast<signed char>(dr - dg);
+            signed char dbDg = static_cast<signed char>(db - dg);
+
+            if (dr > -3 && dr < 2 && dg > -3 && dg < 2 && db > -3 && db < 2) {
+                buffer.push_back(QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+            } else if (drDg > -9 && drDg < 8 && dg > -33 && dg < 32 && dbDg > -9 && dbDg < 8) {
+                buffer.push_back(QOI_OP_LUMA | (dg + 32));
+                buffer.push_back((drDg + 8) << 4 | (dbDg + 8));
+            } else {
+                buffer.push_back(QOI_OP_RGB);
+                buffer.push_back(pixel[0]);
+                buffer.push_back(pixel[1]);
+                buffer.push_back(pixel[2]);
+            }
+        }
+
+        memcpy(previous, pixel, 4);
+    }
+
+    stream.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+    return static_cast<bool>(stream);
+};
+
+// Writes the end marker once every row has been written.
+bool QOIEncoder::finish() {
+    if (rowsWritten != height) {
+        return false;
+    }
+    stream.write(reinterpret_cast<const char*>(QOI_END_MARKER), sizeof(QOI_END_MARKER));
+    return static_cast<bool>(stream);
+};
+
+// Reads the QOI header from the stream.
+QOIDecoder::QOIDecoder(istream& stream)
+    : stream(stream), valid(true), width(0), height(0), channels(0), run(0), inputPosition(0) {
+
+    previous[0] = 0;
+    previous[1] = 0;
+    previous[2] = 0;
+    previous[3] = 255;
+    memset(index, 0, sizeof(index));
+
+    unsigned char header[14];
+    for (int i = 0; i < 14; ++i) {
+        header[i] = nextByte();
+    }
+
+    unsigned int headerWidth = readBigEndian(header + 4);
+    unsigned int headerHeight = readBigEndian(header + 8);
+    channels = header[12];
+
+    // TGAImage keeps its dimensions in shorts, so larger images can't be decoded into one.
+    if (!valid || memcmp(header, "qoif", 4) != 0 || (channels != 3 && channels != 4) ||
+        headerWidth == 0 || headerHeight == 0 || headerWidth > 32767 || headerHeight > 32767) {
+        valid = false;
+        return;
+    }
+
+    width = static_cast<int>(headerWidth);
+    height = static_cast<int>(headerHeight);
+};
+
+// Gets whether the header was read and describes an image this decoder supports.
+bool QOIDecoder::isValid() const {
+    return valid;
+};
+
+int QOIDecoder::getWidth() const {
+    return width;
+};
+
+int QOIDecoder::getHeight() const {
+    return height;
+};
+
+// Decodes the next row of width pixels into BGR order.
+bool QOIDecoder::readRow(unsigned char* row) {
+    for (int x = 0; x < width && valid; ++x) {
+        if (run > 0) {
+            --run;
+        } else {
+            unsigned char tag = nextByte();
+
+            if (tag == QOI_OP_RGB) {
+                previous[0] = nextByte();
+                previous[1] = nextByte();
+                previous[2] = nextByte();
+            } else if (tag == QOI_OP_RGBA) {
+                previous[0] = nextByte();
+                previous[1] = nextByte();
+                previous[2] = nextByte();
+                previous[3] = nextByte();
+            } else if ((tag & QOI_MASK_2) == QOI_OP_INDEX) {
+                memcpy(previous, index[tag], 4);
+            } else if ((tag & QOI_MASK_2) == QOI_OP_DIFF) {
+                previous[0] += ((tag >> 4) & 0x03) - 2;
+                previous[1] += ((tag >> 2) & 0x03) - 2;
+                previous[2] += (tag & 0x03) - 2;
+            } else if ((tag & QOI_MASK_2) == QOI_OP_LUMA) {
+                unsigned char second = nextByte();
+                int dg = (tag & 0x3f) - 32;
+                previous[0] += dg - 8 + ((second >> 4) & 0x0f);
+                previous[1] += dg;
+                previous[2] += dg - 8 + (second & 0x0f);
+            } else {
+                // QOI_OP_RUN: this pixel plus run more repeats of the previous one.
+                run = tag & 0x3f;
+            }
+
+            memcpy(index[colorHash(previous)], previous, 4);
+        }
+
+        row[x * 3] = previous[2];
+        row[x * 3 + 1] = previous[1];
+        row[x * 3 + 2] = previous[0];
+    }
+    return valid;
+};
+
+// Gets the next byte of the stream, refilling the read-ahead chunk when it runs out.
+unsigned char QOIDecoder::nextByte() {
+    if (inputPosition == input.size()) {
+        input.resize(65536);
+        stream.read(reinterpret_cast<char*>(input.data()), input.size());
+        input.resize(static_cast<size_t>(stream.gcount()));
+        inputPosition = 0;
+
+        if (input.empty()) {
+            valid = false;
+            return 0;
+        }
+    }
+    return input[inputPosition++];
+};
@@ -0,0 +1,75 @@
+#ifndef QOI_CODEC_H
+#define QOI_CODEC_H
+
+#include <istream>
+#include <ostream>
+#include <vector>
+using namespace std;
+
+
+// Defining a class that encodes 24-bit pixels to the QOI ("Quite OK Image") format one row at a time.
+// QOI is lossless, usually a fraction of the size of an uncompressed TGA, and needs only a handful of
+// operations per pixel, so encoding runs at close to memory speed. Rows go top to bottom, with pixels
+// in BGR order like TGAImage stores them.
+class QOIEncoder {
+public:
+    // Writes the QOI header for a width x height RGB image to the stream.
+    QOIEncoder(ostream& stream, int width, int height);
+
+    // Encodes the next row of width BGR pixels.
+    bool writeRow(const unsigned char* row);
+
+    // Writes the end marker once every row has been written. Returns false if the stream failed.
+    bool finish();
+
+private:
+    ostream& stream;
+    int width;
+    int height;
+    int rowsWritten;
+
+    // Encoder state, carried across rows so runs and the color index span row boundaries.
+    unsigned char previous[4];
+    unsigned char index[64][4];
+    int run;
+
+    // Bytes encoded for the current row, written to the stream in one go.
+    vector<unsigned char> buffer;
+};
+
+// Defining a class that decodes a QOI file one row at a time.
+class QOIDecoder {
+public:
+    // Reads the QOI header from the stream. Check isValid() before reading rows.
+    explicit QOIDecoder(istream& stream);
+
+    // Gets whether the header was read and describes an image this decoder supports.
+    bool isValid() const;
+
+    int getWidth() const;
+    int getHeight() const;
+
+    // Decodes the next row of width pixels into BGR order. Returns false if the data ran out or is corrupt.
+    bool readRow(unsigned char* row);
+
+private:
+    istream& stream;
+    bool valid;
+    int width;
+    int height;
+    int channels;
+
+    // Decoder state, carried across rows like the encoder's.
+    unsigned char previous[4];
+    unsigned char index[64][4];
+    int run;
+
+    // Chunk of the stream read ahead, so bytes aren't pulled from the stream one at a time.
+    vector<unsigned char> input;
+    size_t inputPosition;
+
+    // Gets the next byte of the stream, setting valid to false if there isn't one.
+    unsigned char nextByte();
+};
+
+#endif // QOI_CODEC_H
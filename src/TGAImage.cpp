@@ -1,13 +1,31 @@
 #include "TGAImage.h"
+#include "Parallel.h"
+#include "QOICodec.h"
 #include <iostream>
 #include <fstream>
 #include <vector>
 #include <cstdint>
 #include <algorithm>
 #include <cmath>
+#include <atomic>
+#include <cctype>
+#include <climits>
 using namespace std;
 
-TGAImage::TGAImage() : header{}, imageData{} {
+namespace {
+
+// Hands out edit generations, shared by every image so they only ever count up.
+unsigned long long nextDirtyGeneration() {
+    static atomic<unsigned long long> generation(0);
+    return ++generation;
+};
+
+// How many edits an image remembers for getDirtyRectsSince.
+const size_t MAX_DIRTY_LOG = 64;
+
+}
+
+TGAImage::TGAImage() : header{}, imageData{}, dirtyLogStart(0) {
     // Set the header properties for the default image.
     header.idLength = 0;
     header.colorMapType = 0;
@@ -21,6 +39,56 @@ TGAImage::TGAImage() : header{}, imageData{} {
     header.imageDescriptor = 0;
 };
 
+// Constructs a black 24-bit image of the given size.
+TGAImage::TGAImage(int width, int height) : TGAImage() {
+    if (!validDimensions(width, height)) {
+        cout << "Error: Can't hold a " << width << "x" << height << " image." << endl;
+        return;
+    }
+    setWidth(width);
+    setHeight(height);
+    imageData.resize(static_cast<size_t>(width) * height * 3);
+};
+
+// Copies another image over this one, marking all of it dirty.
+TGAImage& TGAImage::operator=(const TGAImage& other) {
+    if (this != &other) {
+        header = other.header;
+        imageData = other.imageData;
+        dirtyRects = other.dirtyRects;
+        markDirty(0, 0, getWidth(), getHeight());
+    }
+    return *this;
+};
+
+// Moves another image into this one, marking all of it dirty.
+TGAImage& TGAImage::operator=(TGAImage&& other) {
+    if (this != &other) {
+        header = other.header;
+        imageData = move(other.imageData);
+        dirtyRects = move(other.dirtyRects);
+        markDirty(0, 0, getWidth(), getHeight());
+    }
+    return *this;
+};
+
+// Checks that a width x height 24-bit image can be held.
+bool TGAImage::validDimensions(int width, int height) {
+    return width >= 0 && height >= 0 && width <= 32767 && height <= 32767 &&
+           static_cast<size_t>(width) * height * 3 <= static_cast<size_t>(INT_MAX);
+};
+
+TGAConstImageView::TGAConstImageView() : data(nullptr), width(0), height(0), stride(0) {
+};
+
+TGAConstImageView::TGAConstImageView(const unsigned char* data, int width, int height, int stride)
+    : data(data), width(width), height(height), stride(stride) {
+};
+
+TGAConstImageView::TGAConstImageView(const TGAImageView& view)
+    : data(view.data), width(view.width), height(view.height), stride(view.stride) {
+};
+
 // Function to get the width of the image.
 int TGAImage::getWidth() const {
     return header.width;
@@ -41,6 +109,27 @@ void TGAImage::setHeight(int height) {
     header.height = height;
 };
 
+// Resizes the image, reusing the current allocation when it's big enough.
+void TGAImage::resize(int width, int height) {
+    // Starts from a default header, the old one may have come from a loaded file.
+    header = TGAImage().header;
+    if (!validDimensions(width, height)) {
+        cout << "Error: Can't hold a " << width << "x" << height << " image." << endl;
+        imageData.clear();
+        return;
+    }
+    setWidth(width);
+    setHeight(height);
+    setBitsPerPixel(24);
+    imageData.resize(static_cast<size_t>(width) * height * 3);
+    markDirty(0, 0, width, height);
+};
+
+// Gets the number of bytes the image can hold without reallocating.
+size_t TGAImage::getCapacity() const {
+    return imageData.capacity();
+};
+
 // Function to get the color data of a pixel at (x,y) coordinate. 
 bool TGAImage::getPixelColor(int x, int y, unsigned char& red, unsigned char& green, 
     unsigned char& blue) const {
@@ -109,6 +198,116 @@ bool TGAImage::setPixelColor(int x, int y, unsigned char red, unsigned char gree
     return true;
 };
 
+// Marks a rectangle of the image as changed, clipped to the image.
+void TGAImage::markDirty(int x, int y, int width, int height) {
+    int left = max(0, x);
+    int bottom = max(0, y);
+    int right = min(getWidth(), x + width);
+    int top = min(getHeight(), y + height);
+    if (left >= right || bottom >= top) {
+        return;
+    }
+
+    TGARect rect = { left, bottom, right - left, top - bottom };
+    addRect(dirtyRects, rect);
+
+    dirtyLog.push_back(make_pair(nextDirtyGeneration(), rect));
+    if (dirtyLog.size() > MAX_DIRTY_LOG) {
+        dirtyLogStart = dirtyLog.front().first;
+        dirtyLog.erase(dirtyLog.begin());
+    }
+};
+
+// Gets the generation of the image's latest edit.
+unsigned long long TGAImage::getDirtyGeneration() const {
+    return dirtyLog.empty() ? dirtyLogStart : dirtyLog.back().first;
+};
+
+// Adds the rectangles edited after a generation.
+bool TGAImage::getDirtyRectsSince(unsigned long long generation, vector<TGARect>& rects) const {
+    if (generation < dirtyLogStart) {
+        return false;
+    }
+    for (size_t i = 0; i < dirtyLog.size(); ++i) {
+        if (dirtyLog[i].first > generation) {
+            addRect(rects, dirtyLog[i].second);
+        }
+    }
+    return true;
+};
+
+// Gets the rectangles that changed since the last clearDirty().
+const vector<TGARect>& TGAImage::getDirtyRects() const {
+    return dirtyRects;
+};
+
+// Forgets the changed rectangles.
+void TGAImage::clearDirty() {
+    dirtyRects.clear();
+};
+
+// Adds a rectangle to a list of non-overlapping rectangles, merging it with the ones it touches.
+void TGAImage::addRect(vector<TGARect>& rects, const TGARect& rect, int maxRects) {
+    if (rect.width <= 0 || rect.height <= 0) {
+        return;
+    }
+
+    // Grows the new rectangle to cover every rectangle it overlaps or sits right next to, repeating
+    // until nothing else touches it. Edits are usually strokes, so this keeps the list short.
+    TGARect merged = rect;
+    bool grew = true;
+    while (grew) {
+        grew = false;
+        for (size_t i = 0; i < rects.size(); ++i) {
+            const TGARect& other = rects[i];
+            if (other.x > merged.x + merged.width || merged.x > other.x + other.width ||
+                other.y > merged.y + merged.height || merged.y > other.y + other.height) {
+                continue;
+            }
+
+            int right = max(merged.x + merged.width, other.x + other.width);
+            int top = max(merged.y + merged.height, other.y + other.height);
+            merged.x = min(merged.x, other.x);
+            merged.y = min(merged.y, other.y);
+            merged.width = right - merged.x;
+            merged.height = top - merged.y;
+
+            rects.erase(rects.begin() + i);
+            grew = true;
+            break;
+        }
+    }
+    rects.push_back(merged);
+
+    // Too many scattered rectangles cost more to track than to recompute, so collapse them.
+    if (static_cast<int>(rects.size()) > maxRects) {
+        TGARect bounds = rects[0];
+        for (size_t i = 1; i < rects.size(); ++i) {
+            int right = max(bounds.x + bounds.width, rects[i].x + rects[i].width);
+            int top = max(bounds.y + bounds.height, rects[i].y + rects[i].height);
+            bounds.x = min(bounds.x, rects[i].x);
+            bounds.y = min(bounds.y, rects[i].y);
+            bounds.width = right - bounds.x;
+            bounds.height = top - bounds.y;
+        }
+        rects.assign(1, bounds);
+    }
+};
+
+namespace {
+
+// Checks if a filename ends in .qoi, ignoring case.
+bool hasQOIExtension(const string& filename) {
+    if (filename.size() < 4) {
+        return false;
+    }
+    string extension = filename.substr(filename.size() - 4);
+    transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension == ".qoi";
+};
+
+}
+
 // Function to load in the data of a TGA file.
 bool TGAImage::loadTGA(const string& filename) {
 
@@ -123,39 +322,123 @@ bool TGAImage::loadTGA(const string& filename) {
     // Debug prints to check if the function is called and the filename.
     cout << "Loading TGA image from file: " << filename << endl;
 
+    if (!loadTGA(file)) {
+        return false;
+    }
+
+    // Debug print to check the size of the imageData after loading.
+    cout << "Image data size after loading: " << imageData.size() << " bytes." << endl;
+
+    // Closes the file after reading the data.
+    file.close();
+    return true;
+};
+
+// Function to read the header of a TGA file from a stream.
+bool TGAImage::readTGAHeader(istream& stream, TGAHeader& header) {
     // Reads in the header of the tga file.
-    file.read(&header.idLength, sizeof(header.idLength));
-    file.read(&header.colorMapType, sizeof(header.colorMapType));
-    file.read(&header.dataTypeCode, sizeof(header.dataTypeCode));
-    file.read(reinterpret_cast<char*>(&header.colorMapOrigin), sizeof(header.colorMapOrigin));
-    file.read(reinterpret_cast<char*>(&header.colorMapLength), sizeof(header.colorMapLength));
-    file.read(&header.colorMapDepth, sizeof(header.colorMapDepth));
-    file.read(reinterpret_cast<char*>(&header.xOrigin), sizeof(header.xOrigin));
-    file.read(reinterpret_cast<char*>(&header.yOrigin), sizeof(header.yOrigin));
-    file.read(reinterpret_cast<char*>(&header.width), sizeof(header.width));
-    file.read(reinterpret_cast<char*>(&header.height), sizeof(header.height));
-    file.read(&header.bitsPerPixel, sizeof(header.bitsPerPixel));
-    file.read(&header.imageDescriptor, sizeof(header.imageDescriptor));
-
-    // If the data type of the image is unsupported, return false.
-    if (header.dataTypeCode != 2 && header.dataTypeCode != 10) {
+    stream.read(&header.idLength, sizeof(header.idLength));
+    stream.read(&header.colorMapType, sizeof(header.colorMapType));
+    stream.read(&header.dataTypeCode, sizeof(header.dataTypeCode));
+    stream.read(reinterpret_cast<char*>(&header.colorMapOrigin), sizeof(header.colorMapOrigin));
+    stream.read(reinterpret_cast<char*>(&header.colorMapLength), sizeof(header.colorMapLength));
+    stream.read(&header.colorMapDepth, sizeof(header.colorMapDepth));
+    stream.read(reinterpret_cast<char*>(&header.xOrigin), sizeof(header.xOrigin));
+    stream.read(reinterpret_cast<char*>(&header.yOrigin), sizeof(header.yOrigin));
+    stream.read(reinterpret_cast<char*>(&header.width), sizeof(header.width));
+    stream.read(reinterpret_cast<char*>(&header.height), sizeof(header.height));
+    stream.read(&header.bitsPerPixel, sizeof(header.bitsPerPixel));
+    stream.read(&header.imageDescriptor, sizeof(header.imageDescriptor));
+
+    // Skips the image ID (up to 255 bytes of free text) and the color map, which sit between the header and the pixels.
+    stream.ignore(static_cast<unsigned char>(header.idLength));
+    if (header.colorMapType == 1) {
+        int entryBytes = (static_cast<unsigned char>(header.colorMapDepth) + 7) / 8;
+        stream.ignore(static_cast<streamsize>(static_cast<unsigned short>(header.colorMapLength)) * entryBytes);
+    }
+    return static_cast<bool>(stream);
+};
+
+// Checks that loadTGA can load a file with this header.
+bool TGAImage::canLoadTGA(const TGAHeader& header) {
+    return header.dataTypeCode == 2 && static_cast<unsigned char>(header.bitsPerPixel) == 24 &&
+           header.width > 0 && header.height > 0 && validDimensions(header.width, header.height);
+};
+
+// Function to read just the header of an image file.
+bool TGAImage::probeImage(const string& filename, TGAImageInfo& info) {
+    fstream file(filename, ios_base::in | ios_base::binary);
+    if (!file) {
         return false;
     }
 
+    if (hasQOIExtension(filename)) {
+        // QOI header: "qoif", big-endian width and height, channel count and color space.
+        unsigned char qoiHeader[14];
+        file.read(reinterpret_cast<char*>(qoiHeader), sizeof(qoiHeader));
+        if (!file || qoiHeader[0] != 'q' || qoiHeader[1] != 'o' || qoiHeader[2] != 'i' || qoiHeader[3] != 'f') {
+            return false;
+        }
+        info.width = static_cast<int>((static_cast<unsigned int>(qoiHeader[4]) << 24) | (qoiHeader[5] << 16) | (qoiHeader[6] << 8) | qoiHeader[7]);
+        info.height = static_cast<int>((static_cast<unsigned int>(qoiHeader[8]) << 24) | (qoiHeader[9] << 16) | (qoiHeader[10] << 8) | qoiHeader[11]);
+        info.bitsPerPixel = qoiHeader[12] * 8;
+        info.dataTypeCode = 0;
+        info.isQOI = true;
+
+        // The same checks loadQOI's decoder makes.
+        info.loadable = (qoiHeader[12] == 3 || qoiHeader[12] == 4) && info.width > 0 && info.height > 0 &&
+                        validDimensions(info.width, info.height);
+        return true;
+    }
+
+    TGAHeader fileHeader;
+    if (!readTGAHeader(file, fileHeader)) {
+        return false;
+    }
+    info.width = static_cast<unsigned short>(fileHeader.width);
+    info.height = static_cast<unsigned short>(fileHeader.height);
+    info.bitsPerPixel = static_cast<unsigned char>(fileHeader.bitsPerPixel);
+    info.dataTypeCode = static_cast<unsigned char>(fileHeader.dataTypeCode);
+    info.isQOI = false;
+    info.loadable = canLoadTGA(fileHeader);
+    return true;
+};
+
+// Function to load in TGA data from a stream.
+bool TGAImage::loadTGA(istream& stream) {
+    // If the header can't be read or describes an image this library can't hold, return false before
+    // allocating anything.
+    TGAHeader fileHeader;
+    if (!readTGAHeader(stream, fileHeader) || !canLoadTGA(fileHeader)) {
+        return false;
+    }
+    header = fileHeader;
+
+    // The ID field and color map were skipped rather than kept, so saving writes a header without them.
+    header.idLength = 0;
+    header.colorMapType = 0;
+    header.colorMapOrigin = 0;
+    header.colorMapLength = 0;
+    header.colorMapDepth = 0;
+
     // Calculates the size of the image data based on the header information.
-    int imageSize = header.width * header.height * (static_cast<int>(header.bitsPerPixel) / 8);
+    size_t imageSize = static_cast<size_t>(header.width) * header.height * 3;
 
     // Resizes imageData to store the image data.
     imageData.resize(imageSize);
 
-    // Reads the image data.
-    file.read(reinterpret_cast<char*>(imageData.data()), imageSize);
-
-    // Debug print to check the size of the imageData after loading.
-    cout << "Image data size after loading: " << imageData.size() << " bytes." << endl;
+    // Reads the image data, a truncated file is an error rather than black pixels.
+    stream.read(reinterpret_cast<char*>(imageData.data()), imageSize);
+    if (static_cast<size_t>(stream.gcount()) != imageSize) {
+        cout << "Error: The TGA data ends before the last pixel." << endl;
+        header = TGAImage().header;
+        imageData.clear();
+        return false;
+    }
 
-    // Closes the file after reading the data.
-    file.close();
+    // Every pixel may have changed.
+    dirtyRects.clear();
+    markDirty(0, 0, getWidth(), getHeight());
     return true;
 };
 
@@ -170,46 +453,142 @@ bool TGAImage::saveTGA(const string& filename) const {
         return false;
     }
 
-    // Writes the header data to the file.
-    file.write(&header.idLength, sizeof(header.idLength));
-    file.write(&header.colorMapType, sizeof(header.colorMapType));
-    file.write(&header.dataTypeCode, sizeof(header.dataTypeCode));
-    file.write(reinterpret_cast<const char*>(&header.colorMapOrigin), sizeof(header.colorMapOrigin));
-    file.write(reinterpret_cast<const char*>(&header.colorMapLength), sizeof(header.colorMapLength));
-    file.write(&header.colorMapDepth, sizeof(header.colorMapDepth));
-    file.write(reinterpret_cast<const char*>(&header.xOrigin), sizeof(header.xOrigin));
-    file.write(reinterpret_cast<const char*>(&header.yOrigin), sizeof(header.yOrigin));
-    file.write(reinterpret_cast<const char*>(&header.width), sizeof(header.width));
-    file.write(reinterpret_cast<const char*>(&header.height), sizeof(header.height));
-    file.write(&header.bitsPerPixel, sizeof(header.bitsPerPixel));
-    file.write(&header.imageDescriptor, sizeof(header.imageDescriptor));
+    if (!saveTGA(file)) {
+        file.close();
+        return false;
+    }
+
+    // Closes the file after a successful write and returns true.
+    file.close();
+
+    // Debug print to confirm that the image was saved successfully.
+    cout << "TGA image saved successfully to file: " << filename << endl;
+
+    return true;
+};
+
+// Function to write a TGAImage object to a stream in TGA format.
+bool TGAImage::saveTGA(ostream& stream) const {
+    // Writes the header data to the stream.
+    stream.write(&header.idLength, sizeof(header.idLength));
+    stream.write(&header.colorMapType, sizeof(header.colorMapType));
+    stream.write(&header.dataTypeCode, sizeof(header.dataTypeCode));
+    stream.write(reinterpret_cast<const char*>(&header.colorMapOrigin), sizeof(header.colorMapOrigin));
+    stream.write(reinterpret_cast<const char*>(&header.colorMapLength), sizeof(header.colorMapLength));
+    stream.write(&header.colorMapDepth, sizeof(header.colorMapDepth));
+    stream.write(reinterpret_cast<const char*>(&header.xOrigin), sizeof(header.xOrigin));
+    stream.write(reinterpret_cast<const char*>(&header.yOrigin), sizeof(header.yOrigin));
+    stream.write(reinterpret_cast<const char*>(&header.width), sizeof(header.width));
+    stream.write(reinterpret_cast<const char*>(&header.height), sizeof(header.height));
+    stream.write(&header.bitsPerPixel, sizeof(header.bitsPerPixel));
+    stream.write(&header.imageDescriptor, sizeof(header.imageDescriptor));
 
     // Checks if the header data was written successfully.
-    if (!file) {
+    if (!stream) {
         cout << "Error: Failed to write header data." << endl;
-        file.close();
         return false;
     }
 
-    // Writes the image data to the file.
-    file.write(reinterpret_cast<const char*>(imageData.data()), imageData.size());
+    // Writes the image data to the stream.
+    stream.write(reinterpret_cast<const char*>(imageData.data()), imageData.size());
 
     // Checks if the image data was written successfully.
-    if (!file) {
+    if (!stream) {
         cout << "Error: Failed to write image data." << endl;
-        file.close();
         return false;
     }
 
-    // Closes the file after a successful write and returns true.
-    file.close();
+    return true;
+};
 
-    // Debug print to confirm that the image was saved successfully.
-    cout << "TGA image saved successfully to file: " << filename << endl;
+// Function to load in the data of a QOI file.
+bool TGAImage::loadQOI(const string& filename) {
+    // Open the file in binary.
+    fstream file(filename, ios_base::in | ios_base::binary);
+
+    // If the file can't be opened, return false.
+    if (!file) {
+        return false;
+    }
 
+    if (!loadQOI(file)) {
+        cout << "Error: " << filename << " is not a valid QOI file." << endl;
+        return false;
+    }
     return true;
 };
 
+// Function to load in QOI data from a stream.
+bool TGAImage::loadQOI(istream& stream) {
+    QOIDecoder decoder(stream);
+    if (!decoder.isValid() || !validDimensions(decoder.getWidth(), decoder.getHeight())) {
+        return false;
+    }
+
+    *this = TGAImage(decoder.getWidth(), decoder.getHeight());
+
+    // QOI stores rows top to bottom, TGA images here have their first row at the bottom.
+    int bytesPerRow = getWidth() * 3;
+    for (int y = getHeight() - 1; y >= 0; --y) {
+        if (!decoder.readRow(&imageData[static_cast<size_t>(y) * bytesPerRow])) {
+            return false;
+        }
+    }
+
+    markDirty(0, 0, getWidth(), getHeight());
+    return true;
+};
+
+// Function to save a TGAImage object to a QOI file.
+bool TGAImage::saveQOI(const string& filename) const {
+    // Opens the file in binary mode.
+    fstream file(filename, ios_base::out | ios_base::binary);
+
+    // Returns false if the file doesn't open.
+    if (!file) {
+        cout << "Error: Failed to open the file for writing." << endl;
+        return false;
+    }
+
+    if (!saveQOI(file)) {
+        return false;
+    }
+
+    cout << "QOI image saved successfully to file: " << filename << endl;
+    return true;
+};
+
+// Function to write a TGAImage object to a stream in QOI format.
+bool TGAImage::saveQOI(ostream& stream) const {
+    // Rows are encoded top to bottom, so bottom-origin images (descriptor bit 5 clear) go in reverse.
+    QOIEncoder encoder(stream, getWidth(), getHeight());
+    bool topOrigin = (header.imageDescriptor & 0x20) != 0;
+    int bytesPerRow = getWidth() * 3;
+    for (int row = 0; row < getHeight(); ++row) {
+        int y = topOrigin ? row : getHeight() - 1 - row;
+        if (!encoder.writeRow(&imageData[y * bytesPerRow])) {
+            cout << "Error: Failed to write image data." << endl;
+            return false;
+        }
+    }
+
+    if (!encoder.finish()) {
+        cout << "Error: Failed to write image data." << endl;
+        return false;
+    }
+    return true;
+};
+
+// Loads in a QOI or TGA file depending on its extension.
+bool TGAImage::loadImage(const string& filename) {
+    return hasQOIExtension(filename) ? loadQOI(filename) : loadTGA(filename);
+};
+
+// Saves to a QOI or TGA file depending on the extension.
+bool TGAImage::saveImage(const string& filename) const {
+    return hasQOIExtension(filename) ? saveQOI(filename) : saveTGA(filename);
+};
+
 // Prints pixel data.
 void TGAImage::printPixelData() const {
     int maxPixelsToPrint = min(static_cast<int>(imageData.size() / 3), 10); // Print at most 10 pixels.
@@ -230,308 +609,399 @@ void TGAImage::printPixelData() const {
     }
 };
 
-// Multiplies two TGAImage objects together.
-TGAImage TGAImage::multiplyImages(const TGAImage& topLayer, const TGAImage& bottomLayer) {
-    // Check if the dimensions of the two images are compatible for multiplication.
-    if (topLayer.getWidth() != bottomLayer.getWidth() || topLayer.getHeight() != bottomLayer.getHeight()) {
-        cout << "Error: Dimension mismatch. Images must have the same dimensions for multiplication." << endl;
-        return TGAImage(); // Return an empty image on error.
-    }
-
-    // Create a new TGAImage to store the result of the blending operation.
-    TGAImage resultImage;
-    resultImage.setWidth(topLayer.getWidth());
-    resultImage.setHeight(topLayer.getHeight());
-    resultImage.setBitsPerPixel(24); // Assuming RGB image with 8 bits per channel.
-
-    // Resize the imageData vector to store the calculated pixel values.
-    resultImage.imageData.resize(topLayer.getWidth() * topLayer.getHeight() * 3);
-
-    // Perform the Multiply blending operation for each pixel.
-    for (int y = 0; y < topLayer.getHeight(); ++y) {
-        for (int x = 0; x < topLayer.getWidth(); ++x) {
-            unsigned char topR, topG, topB;
-            unsigned char bottomR, bottomG, bottomB;
-
-            // Get the color values of the top layer at (x, y).
-            topLayer.getPixelColor(x, y, topR, topG, topB);
-
-            // Get the color values of the bottom layer at (x, y).
-            bottomLayer.getPixelColor(x, y, bottomR, bottomG, bottomB);
-
-            // Calculate the blended RGB values using the Multiply blending mode.
-            // Normalize the values between 0 and 1 before the calculation.
-            float newR = (topR / 255.0f) * (bottomR / 255.0f);
-            float newG = (topG / 255.0f) * (bottomG / 255.0f);
-            float newB = (topB / 255.0f) * (bottomB / 255.0f);
-
-            // Convert the normalized values back to the original range (0-255).
-            unsigned char clampedR = static_cast<unsigned char>(newR * 255.0f + 0.5f);
-            unsigned char clampedG = static_cast<unsigned char>(newG * 255.0f + 0.5f);
-            unsigned char clampedB = static_cast<unsigned char>(newB * 255.0f + 0.5f);
-
-            // Set the RGB values in the result image's imageData vector (in BGR order).
-            int pixelIndex = (y * topLayer.getWidth() + x) * 3;
-            resultImage.imageData[pixelIndex] = clampedB;   // Blue channel
-            resultImage.imageData[pixelIndex + 1] = clampedG; // Green channel
-            resultImage.imageData[pixelIndex + 2] = clampedR; // Red channel
-        }
+// Gets a view of the whole image.
+TGAImageView TGAImage::view() {
+    return view(0, 0, getWidth(), getHeight());
+};
+
+TGAConstImageView TGAImage::view() const {
+    return view(0, 0, getWidth(), getHeight());
+};
+
+// Checks that a rectangle is inside the image and its pixels are allocated.
+bool TGAImage::viewFits(int x, int y, int width, int height) const {
+    if (x < 0 || y < 0 || width < 0 || height < 0 || x + width > getWidth() || y + height > getHeight() ||
+        imageData.size() < static_cast<size_t>(getWidth()) * getHeight() * 3) {
+        cout << "Error: View rectangle is outside of the image." << endl;
+        return false;
+    }
+    return true;
+};
+
+// Gets a view of a rectangle of the image, or an empty view if it doesn't fit.
+TGAImageView TGAImage::view(int x, int y, int width, int height) {
+    TGAImageView result = { nullptr, 0, 0, 0 };
+    if (!viewFits(x, y, width, height)) {
+        return result;
+    }
+
+    result.data = imageData.data() + (static_cast<size_t>(y) * getWidth() + x) * 3;
+    result.width = width;
+    result.height = height;
+    result.stride = getWidth() * 3;
+    return result;
+};
+
+TGAConstImageView TGAImage::view(int x, int y, int width, int height) const {
+    if (!viewFits(x, y, width, height)) {
+        return TGAConstImageView();
     }
+    return TGAConstImageView(imageData.data() + (static_cast<size_t>(y) * getWidth() + x) * 3, width, height,
+                             getWidth() * 3);
+};
 
+// Copies the pixels of a view into a new image.
+TGAImage TGAImage::copyView(const TGAConstImageView& source) {
+    TGAImage resultImage(source.width, source.height);
+    copyPixels(source, resultImage.view());
     return resultImage;
 };
 
-// Subtracts one TGAImage object from another.
-TGAImage TGAImage::subtractImages(const TGAImage& topLayer, const TGAImage& bottomLayer) {
-    // Check if the dimensions of both images match.
-    if (bottomLayer.getWidth() != topLayer.getWidth() || bottomLayer.getHeight() != topLayer.getHeight()) {
-        cout << "Error: Dimension mismatch between the two images." << endl;
-        return TGAImage(); // Return an empty image in case of dimension mismatch.
+// Crops a rectangle of an image into a new image.
+TGAImage TGAImage::cropImage(const TGAImage& image, int x, int y, int width, int height) {
+    TGAConstImageView region = image.view(x, y, width, height);
+    if (region.data == nullptr) {
+        return TGAImage(); // Return an empty image if the rectangle doesn't fit.
     }
+    return copyView(region);
+};
 
-    // Create a new TGAImage to store the result of the subtraction.
-    TGAImage resultImage;
-    resultImage.setWidth(bottomLayer.getWidth());
-    resultImage.setHeight(bottomLayer.getHeight());
-    resultImage.setBitsPerPixel(24); // Assuming RGB image with 8 bits per channel.
+// Copies the pixels of one view into another view of the same size, one row at a time.
+bool TGAImage::copyPixels(const TGAConstImageView& source, const TGAImageView& destination) {
+    if (source.width != destination.width || source.height != destination.height) {
+        cout << "Error: Dimension mismatch between the two views." << endl;
+        return false;
+    }
 
-    // Resize the imageData vector to store the calculated pixel values.
-    resultImage.imageData.resize(bottomLayer.getWidth() * bottomLayer.getHeight() * 3);
+    for (int y = 0; y < source.height; ++y) {
+        copy(source.data + y * source.stride, source.data + y * source.stride + source.width * 3,
+             destination.data + y * destination.stride);
+    }
+    return true;
+};
 
-    // Perform the Subtract blending operation for each pixel.
-    for (int y = 0; y < bottomLayer.getHeight(); ++y) {
-        for (int x = 0; x < bottomLayer.getWidth(); ++x) {
-            unsigned char bottomR, bottomG, bottomB;
-            unsigned char topR, topG, topB;
+// Per-channel blend functors. Each takes the first and second layer's value for one channel
+// and returns the blended value, using integer math so the driver loop can be vectorized.
+namespace {
 
-            // Get the color data of the bottom layer pixel.
-            bottomLayer.getPixelColor(x, y, bottomR, bottomG, bottomB);
+// Divides x by 255 with rounding to nearest, exact for 0 <= x <= 65535.
+inline unsigned int div255(unsigned int x) {
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+};
 
-            // Get the color data of the top layer pixel.
-            topLayer.getPixelColor(x, y, topR, topG, topB);
+// C = A * B / 255
+struct MultiplyOp {
+    static inline unsigned char apply(unsigned int top, unsigned int bottom) {
+        return static_cast<unsigned char>(div255(top * bottom));
+    }
+};
 
-            // Calculate the subtracted RGB values.
-            unsigned char newR, newG, newB;
-            newR = bottomR >= topR ? bottomR - topR : 0;
-            newG = bottomG >= topG ? bottomG - topG : 0;
-            newB = bottomB >= topB ? bottomB - topB : 0;
+// C = B - A, clamped at 0.
+struct SubtractOp {
+    static inline unsigned char apply(unsigned int top, unsigned int bottom) {
+        return static_cast<unsigned char>(bottom >= top ? bottom - top : 0);
+    }
+};
 
-            // Set the RGB values in the result image's imageData vector (in BGR order).
-            int pixelIndex = (y * bottomLayer.getWidth() + x) * 3;
-            resultImage.imageData[pixelIndex] = newB; // Blue channel
-            resultImage.imageData[pixelIndex + 1] = newG; // Green channel
-            resultImage.imageData[pixelIndex + 2] = newR; // Red channel
+// C = 255 - (255 - A) * (255 - B) / 255
+struct ScreenOp {
+    static inline unsigned char apply(unsigned int top, unsigned int bottom) {
+        return static_cast<unsigned char>(255 - div255((255 - top) * (255 - bottom)));
+    }
+};
+
+// Overlay keyed on the first layer: multiply the dark half, screen the light half.
+struct OverlayOp {
+    static inline unsigned char apply(unsigned int background, unsigned int foreground) {
+        if (background < 128) {
+            return static_cast<unsigned char>(div255(2 * background * foreground)); // C = 2 * A * B / 255
         }
+        return static_cast<unsigned char>(255 - div255(2 * (255 - background) * (255 - foreground))); // C = 255 - 2 * (255 - A) * (255 - B) / 255
     }
+};
 
-    return resultImage;
+// C = min(A, B)
+struct DarkenOp {
+    static inline unsigned char apply(unsigned int top, unsigned int bottom) {
+        return static_cast<unsigned char>(top < bottom ? top : bottom);
+    }
 };
 
-TGAImage TGAImage::screenImages(const TGAImage& topLayer, const TGAImage& bottomLayer) {
-    // Check if the dimensions of both images match.
-    if (bottomLayer.getWidth() != topLayer.getWidth() || bottomLayer.getHeight() != topLayer.getHeight()) {
-        cout << "Error: Dimension mismatch between the two images." << endl;
-        return TGAImage(); // Return an empty image in case of dimension mismatch.
+// C = max(A, B)
+struct LightenOp {
+    static inline unsigned char apply(unsigned int top, unsigned int bottom) {
+        return static_cast<unsigned char>(top > bottom ? top : bottom);
     }
+};
 
-    // Create a new TGAImage to store the result of the blending.
-    TGAImage resultImage;
-    resultImage.setWidth(bottomLayer.getWidth());
-    resultImage.setHeight(bottomLayer.getHeight());
-    resultImage.setBitsPerPixel(24); // Assuming RGB image with 8 bits per channel.
-
-    // Resize the imageData vector to store the calculated pixel values.
-    resultImage.imageData.resize(bottomLayer.getWidth() * bottomLayer.getHeight() * 3);
-
-    // Perform the Screen blending operation for each pixel.
-    for (int y = 0; y < bottomLayer.getHeight(); ++y) {
-        for (int x = 0; x < bottomLayer.getWidth(); ++x) {
-            unsigned char bottomR, bottomG, bottomB;
-            unsigned char topR, topG, topB;
-
-            // Get the color data of the bottom layer pixel.
-            bottomLayer.getPixelColor(x, y, bottomR, bottomG, bottomB);
-
-            // Get the color data of the top layer pixel.
-            topLayer.getPixelColor(x, y, topR, topG, topB);
-
-            // Convert the color values to normalized floats (0.0 to 1.0).
-            float normBottomR = bottomR / 255.0f;
-            float normBottomG = bottomG / 255.0f;
-            float normBottomB = bottomB / 255.0f;
-
-            float normTopR = topR / 255.0f;
-            float normTopG = topG / 255.0f;
-            float normTopB = topB / 255.0f;
-
-            // Calculate the Screen blending mode values.
-            float newR = 1.0f - (1.0f - normTopR) * (1.0f - normBottomR);
-            float newG = 1.0f - (1.0f - normTopG) * (1.0f - normBottomG);
-            float newB = 1.0f - (1.0f - normTopB) * (1.0f - normBottomB);
-
-            // Convert the normalized floats back to unsigned char (0 to 255).
-            newR = round(newR * 255.0f);
-            newG = round(newG * 255.0f);
-            newB = round(newB * 255.0f);
-
-            // Clamp the values to ensure they stay within the valid range (0 to 255).
-            newR = std::max(0.0f, std::min(255.0f, newR));
-            newG = std::max(0.0f, std::min(255.0f, newG));
-            newB = std::max(0.0f, std::min(255.0f, newB));
-
-            // Set the RGB values in the result image's imageData vector (in BGR order).
-            int pixelIndex = (y * bottomLayer.getWidth() + x) * 3;
-            resultImage.imageData[pixelIndex] = static_cast<unsigned char>(newB); // Blue channel
-            resultImage.imageData[pixelIndex + 1] = static_cast<unsigned char>(newG); // Green channel
-            resultImage.imageData[pixelIndex + 2] = static_cast<unsigned char>(newR); // Red channel
+// C = |A - B|
+struct DifferenceOp {
+    static inline unsigned char apply(unsigned int top, unsigned int bottom) {
+        return static_cast<unsigned char>(top > bottom ? top - bottom : bottom - top);
+    }
+};
+
+// C = B * 255 / (255 - A), clamped at 255.
+struct ColorDodgeOp {
+    static inline unsigned char apply(unsigned int top, unsigned int bottom) {
+        if (bottom == 0) {
+            return 0;
+        }
+        if (top == 255) {
+            return 255;
         }
+        unsigned int value = (bottom * 255 + (255 - top) / 2) / (255 - top);
+        return static_cast<unsigned char>(value > 255 ? 255 : value);
     }
+};
 
-    return resultImage;
+// C = 255 - (255 - B) * 255 / A, clamped at 0.
+struct ColorBurnOp {
+    static inline unsigned char apply(unsigned int top, unsigned int bottom) {
+        if (bottom == 255) {
+            return 255;
+        }
+        if (top == 0) {
+            return 0;
+        }
+        unsigned int value = ((255 - bottom) * 255 + top / 2) / top;
+        return static_cast<unsigned char>(value > 255 ? 0 : 255 - value);
+    }
 };
 
-// Function to perform Overlay blending between two TGAImage objects.
-TGAImage TGAImage::overlayImages(const TGAImage& background, const TGAImage& foreground) {
+// Pegtop soft light: C = (1 - 2A) * B^2 + 2 * A * B, in normalized units.
+// Rearranged as B * (255 * B + 2 * A * (255 - B)) / 255^2 so every term stays non-negative.
+struct SoftLightOp {
+    static inline unsigned char apply(unsigned int top, unsigned int bottom) {
+        unsigned int value = bottom * (255 * bottom + 2 * top * (255 - bottom));
+        return static_cast<unsigned char>((value + 65025 / 2) / 65025);
+    }
+};
+
+// C = min(A + B, 255)
+struct AddOp {
+    static inline unsigned char apply(unsigned int top, unsigned int bottom) {
+        unsigned int value = top + bottom;
+        return static_cast<unsigned char>(value > 255 ? 255 : value);
+    }
+};
+
+}
+
+// Applies a per-channel blend functor to every byte of two equally sized views.
+template <typename BlendOp>
+bool TGAImage::blendViews(const TGAConstImageView& first, const TGAConstImageView& second, const TGAImageView& result) {
+    // Check if the dimensions of the inputs and the result match.
+    if (first.width != second.width || first.height != second.height ||
+        first.width != result.width || first.height != result.height) {
+        cout << "Error: Dimension mismatch between the two images." << endl;
+        return false;
+    }
+
+    // Every channel blends independently of its neighbours, so each row is one flat loop
+    // over bytes (BGR order doesn't matter) that the compiler can vectorize.
+    int bytesPerRow = first.width * 3;
+    parallelRows(first.height, [=](int firstRow, int endRow) {
+        for (int y = firstRow; y < endRow; ++y) {
+            const unsigned char* firstRowData = first.data + y * first.stride;
+            const unsigned char* secondRowData = second.data + y * second.stride;
+            unsigned char* resultRowData = result.data + y * result.stride;
+            for (int i = 0; i < bytesPerRow; ++i) {
+                resultRowData[i] = BlendOp::apply(firstRowData[i], secondRowData[i]);
+            }
+        }
+    });
+
+    return true;
+};
+
+// Applies a per-channel blend functor to two equally sized images, allocating the result.
+template <typename BlendOp>
+TGAImage TGAImage::blendImages(const TGAImage& first, const TGAImage& second) {
     // Check if the dimensions of both images match.
-    if (background.getWidth() != foreground.getWidth() || background.getHeight() != foreground.getHeight()) {
+    if (first.getWidth() != second.getWidth() || first.getHeight() != second.getHeight()) {
         cout << "Error: Dimension mismatch between the two images." << endl;
         return TGAImage(); // Return an empty image in case of dimension mismatch.
     }
 
     // Create a new TGAImage to store the result of the blending.
-    TGAImage resultImage;
-    resultImage.setWidth(background.getWidth());
-    resultImage.setHeight(background.getHeight());
-    resultImage.setBitsPerPixel(24); // Assuming RGB image with 8 bits per channel.
-
-    // Resize the imageData vector to store the calculated pixel values.
-    resultImage.imageData.resize(background.getWidth() * background.getHeight() * 3);
-
-    // Perform the Overlay blending operation for each pixel.
-    for (int y = 0; y < background.getHeight(); ++y) {
-        for (int x = 0; x < background.getWidth(); ++x) {
-            unsigned char backgroundR, backgroundG, backgroundB;
-            unsigned char foregroundR, foregroundG, foregroundB;
-
-            // Get the color data of the background pixel.
-            background.getPixelColor(x, y, backgroundR, backgroundG, backgroundB);
-
-            // Get the color data of the foreground pixel.
-            foreground.getPixelColor(x, y, foregroundR, foregroundG, foregroundB);
-
-            // Calculate the Overlay blending mode values.
-            unsigned char newR, newG, newB;
-            if (backgroundR < 128) {
-                newR = static_cast<unsigned char>(2.0f * backgroundR * foregroundR / 255.0f + 0.5f); // C = 2 * A * B / 255
-            } else {
-                newR = static_cast<unsigned char>(255.0f - 2.0f * (255.0f - backgroundR) * (255.0f - foregroundR) / 255.0f + 0.5f); // C = 255 - 2 * (255 - A) * (255 - B) / 255
-            }
+    TGAImage resultImage(first.getWidth(), first.getHeight());
+    blendViews<BlendOp>(first.view(), second.view(), resultImage.view());
+    return resultImage;
+};
 
-            if (backgroundG < 128) {
-                newG = static_cast<unsigned char>(2.0f * backgroundG * foregroundG / 255.0f + 0.5f); // C = 2 * A * B / 255
-            } else {
-                newG = static_cast<unsigned char>(255.0f - 2.0f * (255.0f - backgroundG) * (255.0f - foregroundG) / 255.0f + 0.5f); // C = 255 - 2 * (255 - A) * (255 - B) / 255
-            }
+// Multiplies two TGAImage objects together.
+TGAImage TGAImage::multiplyImages(const TGAImage& topLayer, const TGAImage& bottomLayer) {
+    return blendImages<MultiplyOp>(topLayer, bottomLayer);
+};
 
-            if (backgroundB < 128) {
-                newB = static_cast<unsigned char>(2.0f * backgroundB * foregroundB / 255.0f + 0.5f); // C = 2 * A * B / 255
-            } else {
-                newB = static_cast<unsigned char>(255.0f - 2.0f * (255.0f - backgroundB) * (255.0f - foregroundB) / 255.0f + 0.5f); // C = 255 - 2 * (255 - A) * (255 - B) / 255
-            }
+// Subtracts one TGAImage object from another.
+TGAImage TGAImage::subtractImages(const TGAImage& topLayer, const TGAImage& bottomLayer) {
+    return blendImages<SubtractOp>(topLayer, bottomLayer);
+};
 
-            // Set the RGB values in the result image's imageData vector (in BGR order).
-            int pixelIndex = (y * background.getWidth() + x) * 3;
-            resultImage.imageData[pixelIndex] = newB; // Blue channel
-            resultImage.imageData[pixelIndex + 1] = newG; // Green channel
-            resultImage.imageData[pixelIndex + 2] = newR; // Red channel
-        }
-    }
+// Screen blends two TGAImage objects together.
+TGAImage TGAImage::screenImages(const TGAImage& topLayer, const TGAImage& bottomLayer) {
+    return blendImages<ScreenOp>(topLayer, bottomLayer);
+};
 
-    return resultImage;
+// Function to perform Overlay blending between two TGAImage objects.
+TGAImage TGAImage::overlayImages(const TGAImage& background, const TGAImage& foreground) {
+    return blendImages<OverlayOp>(background, foreground);
 };
 
-// Function that adds 200 to the green channel.
-TGAImage TGAImage::add200Green(const TGAImage& image) {
-    // Create a copy of the input image
-    TGAImage resultImage = image; 
+// Keeps the darker of the two layers for each channel.
+TGAImage TGAImage::darkenImages(const TGAImage& topLayer, const TGAImage& bottomLayer) {
+    return blendImages<DarkenOp>(topLayer, bottomLayer);
+};
 
-    // Get image dimensions
-    int width = resultImage.getWidth();
-    int height = resultImage.getHeight();
+// Keeps the lighter of the two layers for each channel.
+TGAImage TGAImage::lightenImages(const TGAImage& topLayer, const TGAImage& bottomLayer) {
+    return blendImages<LightenOp>(topLayer, bottomLayer);
+};
 
-    // Modify the green channel of each pixel
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            unsigned char red, green, blue;
-            // Get the color data of the current pixel
-            resultImage.getPixelColor(x, y, red, green, blue);
+// Takes the absolute difference between two TGAImage objects.
+TGAImage TGAImage::differenceImages(const TGAImage& topLayer, const TGAImage& bottomLayer) {
+    return blendImages<DifferenceOp>(topLayer, bottomLayer);
+};
 
-            // Add 200 to the green channel
-            int newGreen = green + 200;
+// Brightens the bottom layer based on the top layer.
+TGAImage TGAImage::colorDodgeImages(const TGAImage& topLayer, const TGAImage& bottomLayer) {
+    return blendImages<ColorDodgeOp>(topLayer, bottomLayer);
+};
 
-            // Clamp the value to the range [0, 255]
-            newGreen = std::min(255, std::max(0, newGreen));
+// Darkens the bottom layer based on the top layer.
+TGAImage TGAImage::colorBurnImages(const TGAImage& topLayer, const TGAImage& bottomLayer) {
+    return blendImages<ColorBurnOp>(topLayer, bottomLayer);
+};
 
-            // Update the pixel with the modified color values
-            resultImage.setPixelColor(x, y, red, static_cast<unsigned char>(newGreen), blue);
-        }
-    }
+// Soft light blends two TGAImage objects together.
+TGAImage TGAImage::softLightImages(const TGAImage& topLayer, const TGAImage& bottomLayer) {
+    return blendImages<SoftLightOp>(topLayer, bottomLayer);
+};
 
-    return resultImage;
+// Hard light is overlay with the roles of the layers swapped, so the top layer picks multiply or screen.
+TGAImage TGAImage::hardLightImages(const TGAImage& topLayer, const TGAImage& bottomLayer) {
+    return blendImages<OverlayOp>(topLayer, bottomLayer);
 };
 
-// Scales the red and blue channels.
-TGAImage TGAImage::scaleChannels(const TGAImage& image, float redScale, float blueScale) {
-    TGAImage resultImage = image; // Create a copy of the input image
+// Adds two TGAImage objects together, saturating at 255.
+TGAImage TGAImage::addImages(const TGAImage& topLayer, const TGAImage& bottomLayer) {
+    return blendImages<AddOp>(topLayer, bottomLayer);
+};
+
+// View versions of the blend operations, writing into an existing view.
+bool TGAImage::multiplyImages(const TGAConstImageView& topLayer, const TGAConstImageView& bottomLayer, const TGAImageView& result) {
+    return blendViews<MultiplyOp>(topLayer, bottomLayer, result);
+};
+
+bool TGAImage::subtractImages(const TGAConstImageView& topLayer, const TGAConstImageView& bottomLayer, const TGAImageView& result) {
+    return blendViews<SubtractOp>(topLayer, bottomLayer, result);
+};
+
+bool TGAImage::screenImages(const TGAConstImageView& topLayer, const TGAConstImageView& bottomLayer, const TGAImageView& result) {
+    return blendViews<ScreenOp>(topLayer, bottomLayer, result);
+};
+
+bool TGAImage::overlayImages(const TGAConstImageView& background, const TGAConstImageView& foreground, const TGAImageView& result) {
+    return blendViews<OverlayOp>(background, foreground, result);
+};
+
+bool TGAImage::darkenImages(const TGAConstImageView& topLayer, const TGAConstImageView& bottomLayer, const TGAImageView& result) {
+    return blendViews<DarkenOp>(topLayer, bottomLayer, result);
+};
+
+bool TGAImage::lightenImages(const TGAConstImageView& topLayer, const TGAConstImageView& bottomLayer, const TGAImageView& result) {
+    return blendViews<LightenOp>(topLayer, bottomLayer, result);
+};
+
+bool TGAImage::differenceImages(const TGAConstImageView& topLayer, const TGAConstImageView& bottomLayer, const TGAImageView& result) {
+    return blendViews<DifferenceOp>(topLayer, bottomLayer, result);
+};
 
-    // Get image dimensions
-    int width = resultImage.getWidth();
-    int height = resultImage.getHeight();
+bool TGAImage::colorDodgeImages(const TGAConstImageView& topLayer, const TGAConstImageView& bottomLayer, const TGAImageView& result) {
+    return blendViews<ColorDodgeOp>(topLayer, bottomLayer, result);
+};
+
+bool TGAImage::colorBurnImages(const TGAConstImageView& topLayer, const TGAConstImageView& bottomLayer, const TGAImageView& result) {
+    return blendViews<ColorBurnOp>(topLayer, bottomLayer, result);
+};
 
-    // Scale the red and blue channels of each pixel
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            unsigned char red, green, blue;
-            // Get the color data of the current pixel
-            resultImage.getPixelColor(x, y, red, green, blue);
+bool TGAImage::softLightImages(const TGAConstImageView& topLayer, const TGAConstImageView& bottomLayer, const TGAImageView& result) {
+    return blendViews<SoftLightOp>(topLayer, bottomLayer, result);
+};
 
-            // Scale the red and blue channels
-            int newRed = red * redScale;
-            int newBlue = blue * blueScale;
+bool TGAImage::hardLightImages(const TGAConstImageView& topLayer, const TGAConstImageView& bottomLayer, const TGAImageView& result) {
+    return blendViews<OverlayOp>(topLayer, bottomLayer, result);
+};
 
-            // Clamp the values to the range [0, 255]
-            newRed = std::min(255, std::max(0, newRed));
-            newBlue = std::min(255, std::max(0, newBlue));
+bool TGAImage::addImages(const TGAConstImageView& topLayer, const TGAConstImageView& bottomLayer, const TGAImageView& result) {
+    return blendViews<AddOp>(topLayer, bottomLayer, result);
+};
 
-            // Update the pixel with the modified color values
-            resultImage.setPixelColor(x, y, static_cast<unsigned char>(newRed), green, static_cast<unsigned char>(newBlue));
+// Looks up the view version of a blend operation by its short name.
+TGAImage::BlendFunction TGAImage::findBlend(const string& name) {
+    static const struct {
+        const char* name;
+        BlendFunction function;
+    } blends[] = {
+        { "multiply", &TGAImage::multiplyImages },
+        { "subtract", &TGAImage::subtractImages },
+        { "screen", &TGAImage::screenImages },
+        { "overlay", &TGAImage::overlayImages },
+        { "darken", &TGAImage::darkenImages },
+        { "lighten", &TGAImage::lightenImages },
+        { "difference", &TGAImage::differenceImages },
+        { "colordodge", &TGAImage::colorDodgeImages },
+        { "colorburn", &TGAImage::colorBurnImages },
+        { "softlight", &TGAImage::softLightImages },
+        { "hardlight", &TGAImage::hardLightImages },
+        { "add", &TGAImage::addImages },
+    };
+
+    for (size_t i = 0; i < sizeof(blends) / sizeof(blends[0]); ++i) {
+        if (name == blends[i].name) {
+            return blends[i].function;
         }
     }
+    return nullptr;
+};
 
+// Function that adds 200 to the green channel.
+TGAImage TGAImage::add200Green(const TGAImage& image) {
+    // Create a copy of the input image and adjust it in place.
+    TGAImage resultImage = image;
+    add200Green(resultImage.view(), resultImage.view());
     return resultImage;
 };
 
+// Adds 200 to the green channel of a view, saturating at 255.
+bool TGAImage::add200Green(const TGAConstImageView& image, const TGAImageView& result) {
+    return colorMatrix(image, TGAColorMatrix::scale(1.0f, 1.0f, 1.0f, 0.0f, 200.0f, 0.0f), result);
+};
+
+// Scales the red and blue channels.
+TGAImage TGAImage::scaleChannels(const TGAImage& image, float redScale, float blueScale) {
+    // Create a copy of the input image and adjust it in place.
+    TGAImage resultImage = image;
+    scaleChannels(resultImage.view(), redScale, blueScale, resultImage.view());
+    return resultImage;
+};
+
+// Scales the red and blue channels of a view, rounding and clamping to [0, 255].
+bool TGAImage::scaleChannels(const TGAConstImageView& image, float redScale, float blueScale, const TGAImageView& result) {
+    return colorMatrix(image, TGAColorMatrix::scale(redScale, 1.0f, blueScale), result);
+};
+
 bool TGAImage::separateChannels(const TGAImage& image, const std::string& redFilename,
                                        const std::string& greenFilename, const std::string& blueFilename) {
     
-    int width = image.getWidth();
-    int height = image.getHeight();
-
+    // Copies keep the header of the input, each is then overwritten with one channel in all three.
     TGAImage redChannelImage = image;
     TGAImage greenChannelImage = image;
     TGAImage blueChannelImage = image;
-
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            unsigned char red, green, blue;
-            image.getPixelColor(x, y, red, green, blue);
-
-            // Create separate images for each channel
-            redChannelImage.setPixelColor(x, y, red, red, red);
-            greenChannelImage.setPixelColor(x, y, green, green, green);
-            blueChannelImage.setPixelColor(x, y, blue, blue, blue);
-        }
-    }
+    separateChannels(image.view(), redChannelImage.view(), greenChannelImage.view(), blueChannelImage.view());
 
     // Save each channel as a separate file
     if (!redChannelImage.saveTGA(redFilename)) {
@@ -556,138 +1026,235 @@ bool TGAImage::separateChannels(const TGAImage& image, const std::string& redFil
 
 // Combines the red of one image, green of another, and blue of a third into a single image.
 TGAImage TGAImage::combineChannels(const TGAImage& layerRed, const TGAImage& layerGreen, const TGAImage& layerBlue) {
-    // Check if the dimensions of all images match.
-    if (layerRed.getWidth() != layerGreen.getWidth() || layerRed.getHeight() != layerGreen.getHeight() ||
-        layerRed.getWidth() != layerBlue.getWidth() || layerRed.getHeight() != layerBlue.getHeight()) {
-        cout << "Error: Dimension mismatch between the input images." << endl;
+    // Create a new TGAImage to store the combined image.
+    TGAImage resultImage(layerRed.getWidth(), layerRed.getHeight());
+    if (!combineChannels(layerRed.view(), layerGreen.view(), layerBlue.view(), resultImage.view())) {
         return TGAImage(); // Return an empty image in case of dimension mismatch.
     }
+    return resultImage;
+};
 
-    // Create a new TGAImage to store the combined image.
-    TGAImage resultImage;
-    resultImage.setWidth(layerRed.getWidth());
-    resultImage.setHeight(layerRed.getHeight());
-
-    // Resize the imageData vector to store the combined pixel values.
-    resultImage.imageData.resize(layerRed.getWidth() * layerRed.getHeight() * 3);
-
-    // Combine the RGB channels of each pixel from the three input images.
-    for (int y = 0; y < layerRed.getHeight(); ++y) {
-        for (int x = 0; x < layerRed.getWidth(); ++x) {
-            unsigned char red, green, blue;
-
-            // Get the color data of the current pixel from each layer.
-            layerRed.getPixelColor(x, y, red, green, blue);
-            resultImage.imageData[(y * layerRed.getWidth() + x) * 3 + 2] = red; // Red channel
-
-            layerGreen.getPixelColor(x, y, red, green, blue);
-            resultImage.imageData[(y * layerRed.getWidth() + x) * 3 + 1] = green; // Green channel
+// Separates the channels of a view into three gray views, each may be the input itself.
+bool TGAImage::separateChannels(const TGAConstImageView& image, const TGAImageView& redResult,
+                                const TGAImageView& greenResult, const TGAImageView& blueResult) {
+    const TGAConstImageView results[3] = { redResult, greenResult, blueResult };
+    for (int i = 0; i < 3; ++i) {
+        if (results[i].width != image.width || results[i].height != image.height) {
+            cout << "Error: Dimension mismatch between the two views." << endl;
+            return false;
+        }
+    }
 
-            layerBlue.getPixelColor(x, y, red, green, blue);
-            resultImage.imageData[(y * layerRed.getWidth() + x) * 3] = blue; // Blue channel
+    int width = image.width;
+    parallelRows(image.height, [=](int firstRow, int endRow) {
+        for (int y = firstRow; y < endRow; ++y) {
+            const unsigned char* in = image.data + y * image.stride;
+            unsigned char* red = redResult.data + y * redResult.stride;
+            unsigned char* green = greenResult.data + y * greenResult.stride;
+            unsigned char* blue = blueResult.data + y * blueResult.stride;
+            for (int x = 0; x < width * 3; x += 3) {
+                // Reads the whole pixel first, in case a result is the input.
+                unsigned char b = in[x];
+                unsigned char g = in[x + 1];
+                unsigned char r = in[x + 2];
+                red[x] = red[x + 1] = red[x + 2] = r;
+                green[x] = green[x + 1] = green[x + 2] = g;
+                blue[x] = blue[x + 1] = blue[x + 2] = b;
+            }
         }
+    });
+    return true;
+};
+
+// Takes each channel straight from its layer's bytes. The result may be one of the layers.
+bool TGAImage::combineChannels(const TGAConstImageView& layerRed, const TGAConstImageView& layerGreen,
+                               const TGAConstImageView& layerBlue, const TGAImageView& result) {
+    // Check if the dimensions of all images match.
+    if (layerRed.width != layerGreen.width || layerRed.height != layerGreen.height ||
+        layerRed.width != layerBlue.width || layerRed.height != layerBlue.height ||
+        layerRed.width != result.width || layerRed.height != result.height) {
+        cout << "Error: Dimension mismatch between the input images." << endl;
+        return false;
     }
 
-    return resultImage;
+    int width = result.width;
+    parallelRows(result.height, [=](int firstRow, int endRow) {
+        for (int y = firstRow; y < endRow; ++y) {
+            const unsigned char* red = layerRed.data + y * layerRed.stride;
+            const unsigned char* green = layerGreen.data + y * layerGreen.stride;
+            const unsigned char* blue = layerBlue.data + y * layerBlue.stride;
+            unsigned char* destination = result.data + y * result.stride;
+            for (int x = 0; x < width * 3; x += 3) {
+                unsigned char b = blue[x];
+                unsigned char g = green[x + 1];
+                unsigned char r = red[x + 2];
+                destination[x] = b;
+                destination[x + 1] = g;
+                destination[x + 2] = r;
+            }
+        }
+    });
+    return true;
 };
 
 // Flips an image 180 degrees
 TGAImage TGAImage::flipImage180(const TGAImage& image) {
     // TGAImage object to store the flipped image.
-    TGAImage flippedImage;
+    TGAImage flippedImage(image.getWidth(), image.getHeight());
+    flipImage180(image.view(), flippedImage.view());
+    return flippedImage;
+};
 
-    // Copy the header information from the original image to the flipped image.
-    flippedImage.setWidth(image.getWidth());
-    flippedImage.setHeight(image.getHeight());
-    flippedImage.imageData = image.imageData;
+// Flips a view 180 degrees. Pixel (x, y) and its mirror (width - 1 - x, height - 1 - y) are swapped as a
+// pair, so the result may be the input itself.
+bool TGAImage::flipImage180(const TGAConstImageView& image, const TGAImageView& result) {
+    if (image.width != result.width || image.height != result.height) {
+        cout << "Error: Dimension mismatch between the two views." << endl;
+        return false;
+    }
+
+    int width = image.width;
+    int height = image.height;
+
+    // Each band takes rows from the bottom half and their mirrors from the top half.
+    parallelRows((height + 1) / 2, [=](int firstRow, int endRow) {
+        for (int y = firstRow; y < endRow; ++y) {
+            int mirrorY = height - 1 - y;
+            const unsigned char* in = image.data + y * image.stride;
+            const unsigned char* mirrorIn = image.data + mirrorY * image.stride;
+            unsigned char* out = result.data + y * result.stride;
+            unsigned char* mirrorOut = result.data + mirrorY * result.stride;
+
+            // The middle row of an odd height is its own mirror, so only its left half is walked.
+            int pairCount = y == mirrorY ? (width + 1) / 2 : width;
+            for (int x = 0; x < pairCount; ++x) {
+                int offset = x * 3;
+                int mirrorOffset = (width - 1 - x) * 3;
+                unsigned char pixel[3] = { in[offset], in[offset + 1], in[offset + 2] };
+                unsigned char mirrorPixel[3] = { mirrorIn[mirrorOffset], mirrorIn[mirrorOffset + 1], mirrorIn[mirrorOffset + 2] };
+                for (int channel = 0; channel < 3; ++channel) {
+                    out[offset + channel] = mirrorPixel[channel];
+                    mirrorOut[mirrorOffset + channel] = pixel[channel];
+                }
+            }
+        }
+    });
+    return true;
+};
 
-    // Calculate the number of bytes per scanline in the image.
-    int bytesPerScanline = image.getWidth() * 3; // Assuming 24 bits per pixel (RGB).
+// Fills rows [firstRow, endRow) of a half-size level with 2x2 box-filtered pixels of the level above.
+void TGAImage::downsampleRows(const TGAImage& source, TGAImage& level, int firstRow, int endRow) {
+    int sourceWidth = source.getWidth();
+    int sourceHeight = source.getHeight();
+    int levelWidth = level.getWidth();
+
+    for (int y = firstRow; y < endRow; ++y) {
+        // Clamp the second row and column so 1-pixel-wide levels reuse their only row or column.
+        const unsigned char* row0 = &source.imageData[(2 * y) * sourceWidth * 3];
+        const unsigned char* row1 = &source.imageData[min(2 * y + 1, sourceHeight - 1) * sourceWidth * 3];
+        unsigned char* out = &level.imageData[y * levelWidth * 3];
+
+        for (int x = 0; x < levelWidth; ++x) {
+            int left = 2 * x * 3;
+            int right = min(2 * x + 1, sourceWidth - 1) * 3;
+            for (int channel = 0; channel < 3; ++channel) {
+                int sum = row0[left + channel] + row0[right + channel] + row1[left + channel] + row1[right + channel];
+                out[x * 3 + channel] = static_cast<unsigned char>((sum + 2) >> 2);
+            }
+        }
+    }
+};
 
-    // Loop through each row in the image and swap the data to flip it over the vertical axis.
-    for (int y = 0; y < image.getHeight(); y++) {
-        int rowOffset = y * bytesPerScanline;
+// Builds every power-of-two level of an image in a single streaming pass.
+vector<TGAImage> TGAImage::buildPyramid(const TGAImage& image) {
+    vector<TGAImage> levels;
+    if (image.getWidth() <= 0 || image.getHeight() <= 0) {
+        cout << "Error: Cannot build a pyramid of an empty image." << endl;
+        return levels;
+    }
 
-        // Reverse the order of the pixels in the row.
-        for (int x = 0; x < image.getWidth() / 2; x++) {
-            int leftPixelOffset = rowOffset + x * 3;
-            int rightPixelOffset = rowOffset + (image.getWidth() - x - 1) * 3;
+    // Level 0 is the image itself, each following level halves both dimensions until 1x1.
+    levels.push_back(image);
+    while (levels.back().getWidth() > 1 || levels.back().getHeight() > 1) {
+        TGAImage level;
+        level.setWidth(max(1, levels.back().getWidth() / 2));
+        level.setHeight(max(1, levels.back().getHeight() / 2));
+        level.setBitsPerPixel(24);
+        level.imageData.resize(level.getWidth() * level.getHeight() * 3);
+        levels.push_back(level);
+    }
 
-            // Swap the pixels (R, G, B components) between left and right sides of the row.
-            for (int channel = 0; channel < 3; channel++) {
-                std::swap(flippedImage.imageData[leftPixelOffset + channel], flippedImage.imageData[rightPixelOffset + channel]);
+    // The base image is streamed in bands of 2^streamedLevels rows. Each band produces its rows of
+    // every streamed level straight from the previous level's rows while they are still in cache,
+    // and bands are independent, so they run on separate threads.
+    int streamedLevels = min(static_cast<int>(levels.size()) - 1, 6);
+    int bandHeight = 1 << streamedLevels;
+    int bandCount = (image.getHeight() + bandHeight - 1) / bandHeight;
+
+    parallelRows(bandCount, [&](int firstBand, int endBand) {
+        for (int band = firstBand; band < endBand; ++band) {
+            for (int level = 1; level <= streamedLevels; ++level) {
+                int firstRow = (band * bandHeight) >> level;
+                int endRow = min(((band + 1) * bandHeight) >> level, levels[level].getHeight());
+                downsampleRows(levels[level - 1], levels[level], firstRow, endRow);
             }
         }
+    }, 1);
+
+    // The remaining levels are at most 1/64th the size of the base, so finish them on this thread.
+    for (size_t level = streamedLevels + 1; level < levels.size(); ++level) {
+        downsampleRows(levels[level - 1], levels[level], 0, levels[level].getHeight());
     }
 
-    // Loop through each column and swap the data to flip it over the horizontal axis.
-    for (int y = 0; y < image.getHeight() / 2; y++) {
-        int topRowOffset = y * bytesPerScanline;
-        int bottomRowOffset = (image.getHeight() - y - 1) * bytesPerScanline;
+    return levels;
+};
+
+// Builds the pyramid of an image and saves each level as its own TGA file.
+bool TGAImage::savePyramid(const TGAImage& image, const string& baseFilename) {
+    vector<TGAImage> levels = buildPyramid(image);
+    if (levels.empty()) {
+        return false;
+    }
 
-        // Swap the entire rows between top and bottom.
-        for (int i = 0; i < bytesPerScanline; i++) {
-            std::swap(flippedImage.imageData[topRowOffset + i], flippedImage.imageData[bottomRowOffset + i]);
+    for (size_t level = 0; level < levels.size(); ++level) {
+        string levelFilename = baseFilename + "_level" + to_string(level) + ".tga";
+        if (!levels[level].saveTGA(levelFilename)) {
+            cout << "Error saving pyramid level " << level << "." << endl;
+            return false;
         }
     }
 
-    return flippedImage;
+    return true;
 };
 
-/*Couldn't get it work
-// Creates a 2x2 grid image from 4 images.
+// Creates a 2x2 grid image from 4 images by copying each one into its quarter of the result.
 TGAImage TGAImage::gridImage(const TGAImage& bottomLeftImage, const TGAImage& bottomRightImage,
-                          const TGAImage& topLeftImage, const TGAImage& topRightImage) {
+                             const TGAImage& topLeftImage, const TGAImage& topRightImage) {
 
     // Calculate the dimensions of the gridResultImage.
     int gridWidth = bottomLeftImage.getWidth() + bottomRightImage.getWidth();
     int gridHeight = bottomLeftImage.getHeight() + topLeftImage.getHeight();
 
-    TGAImage gridResultImage;
-    gridResultImage.setWidth(gridWidth);
-    gridResultImage.setHeight(gridHeight);
-    gridResultImage.imageData.resize(gridWidth * gridHeight * 3);
-
-    // Variable to keep track of the index in the gridResultImage's imageData vector.
-    int pixelIndex = 0;
-
-    for (int y = 0; y < gridHeight; ++y) {
-        for (int x = 0; x < gridWidth; ++x) {
-            unsigned char red, green, blue;
-            
-            // Load bottomLeftImage and bottomRightImage line by line.
-            if (y < bottomLeftImage.getHeight()) {
-                // Load the bottomLeftImage line.
-                if (x < bottomLeftImage.getWidth()) {
-                    bottomLeftImage.getPixelColor(x, y, red, green, blue);
-                }
-                // Load the bottomRightImage line.
-                else {
-                    bottomRightImage.getPixelColor(x - bottomLeftImage.getWidth(), y, red, green, blue);
-                }
-            }
-            // Load the topLeftImage and topRightImage line by line.
-            else {
-                // Load the topLeftImage line.
-                if (x < topLeftImage.getWidth()) {
-                    topLeftImage.getPixelColor(x, y - bottomLeftImage.getHeight(), red, green, blue);
-                }
-                // Load the topRightImage line.
-                else {
-                    topRightImage.getPixelColor(x - topLeftImage.getWidth(), y - bottomLeftImage.getHeight(), red, green, blue);
-                }
-            }
+    TGAImage gridResultImage(gridWidth, gridHeight);
 
-            // Set the RGB values in the gridResultImage's imageData vector (in BGR order).
-            gridResultImage.imageData[pixelIndex] = blue;    // Blue channel
-            pixelIndex++;
-            gridResultImage.imageData[pixelIndex] = green;   // Green channel
-            pixelIndex++;
-            gridResultImage.imageData[pixelIndex] = red;     // Red channel
-            pixelIndex++;
-        }
+    // Rows are stored bottom to top, so the bottom images go in the first rows of the result.
+    TGAImageView bottomLeft = gridResultImage.view(0, 0, bottomLeftImage.getWidth(), bottomLeftImage.getHeight());
+    TGAImageView bottomRight = gridResultImage.view(bottomLeftImage.getWidth(), 0,
+                                                    bottomRightImage.getWidth(), bottomRightImage.getHeight());
+    TGAImageView topLeft = gridResultImage.view(0, bottomLeftImage.getHeight(),
+                                                topLeftImage.getWidth(), topLeftImage.getHeight());
+    TGAImageView topRight = gridResultImage.view(topLeftImage.getWidth(), bottomLeftImage.getHeight(),
+                                                 topRightImage.getWidth(), topRightImage.getHeight());
+
+    if (bottomLeft.data == nullptr || bottomRight.data == nullptr || topLeft.data == nullptr || topRight.data == nullptr) {
+        cout << "Error: The four images don't fit together in a 2x2 grid." << endl;
+        return TGAImage();
     }
 
+    copyPixels(bottomLeftImage.view(), bottomLeft);
+    copyPixels(bottomRightImage.view(), bottomRight);
+    copyPixels(topLeftImage.view(), topLeft);
+    copyPixels(topRightImage.view(), topRight);
+
     return gridResultImage;
 };
-*/
\ No newline at end of file
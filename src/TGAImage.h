@@ -1,7 +1,10 @@
 #ifndef TGA_IMAGE_H
 #define TGA_IMAGE_H
 
+#include <istream>
+#include <ostream>
 #include <string>
+#include <utility>
 #include <vector>
 using namespace std;
 
@@ -22,16 +25,111 @@ struct TGAHeader {
     char imageDescriptor;
 };
 
+// Defining a structure that refers to a rectangle of pixels inside an image without copying them.
+// Pixels are stored in BGR order, and stride is the number of bytes from one row to the next.
+struct TGAImageView {
+    unsigned char* data;
+    int width;
+    int height;
+    int stride;
+};
+
+// Read-only version of TGAImageView, any writable view can be passed where one is expected.
+struct TGAConstImageView {
+    const unsigned char* data;
+    int width;
+    int height;
+    int stride;
+
+    TGAConstImageView();
+    TGAConstImageView(const unsigned char* data, int width, int height, int stride);
+    TGAConstImageView(const TGAImageView& view);
+};
+
+// Defining a structure to hold a rectangle of pixels, used to track which parts of an image changed.
+struct TGARect {
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+// Defining a structure to hold a 3x4 color matrix. Rows give the output red, green and blue, and each row holds
+// the weights of the input red, green and blue followed by an offset in 0-255 units. Results saturate to [0, 255].
+struct TGAColorMatrix {
+    float m[3][4];
+
+    // Leaves every color unchanged.
+    static TGAColorMatrix identity();
+
+    // Takes each output channel from an input channel (0 = red, 1 = green, 2 = blue), e.g. swizzle(2, 1, 0) swaps red and blue.
+    // Prints an error and returns the identity if a source is out of range.
+    static TGAColorMatrix swizzle(int redSource, int greenSource, int blueSource);
+
+    // Scales each channel and then adds an offset to it.
+    static TGAColorMatrix scale(float redScale, float greenScale, float blueScale,
+                                float redOffset = 0.0f, float greenOffset = 0.0f, float blueOffset = 0.0f);
+
+    // Replaces each color with its Rec. 601 luma.
+    static TGAColorMatrix desaturate();
+
+    // The classic sepia tone.
+    static TGAColorMatrix sepia();
+};
+
+// Defining a structure to hold what a file's header says about its image, read without touching the pixels.
+struct TGAImageInfo {
+    int width;
+    int height;
+    int bitsPerPixel;
+    int dataTypeCode; // TGA data type (2: uncompressed, 10: RLE), or 0 for a QOI file
+    bool isQOI;
+    bool loadable;    // whether loadImage can load the file, e.g. false for an RLE or 32-bit TGA
+};
+
 // Defining a class to hold the image data.
 class TGAImage {
     // The TGAImage is made up of a header and image data.
     TGAHeader header;
     vector<unsigned char> imageData;
 
+    // Rectangles of pixels that changed since the last clearDirty().
+    vector<TGARect> dirtyRects;
+
+    // The most recent edits with their generations, for readers that track what they have seen
+    // themselves. Edits up to dirtyLogStart may have been dropped from the log.
+    vector<pair<unsigned long long, TGARect> > dirtyLog;
+    unsigned long long dirtyLogStart;
+
 public:
+    // Luma weightings for grayscale conversion: ITU-R BT.601 (SD video, JPEG) or BT.709 (HD video, sRGB).
+    enum LumaStandard {
+        Rec601,
+        Rec709
+    };
+
+    // Blend operations that read two views and write into a third.
+    typedef bool (*BlendFunction)(const TGAConstImageView&, const TGAConstImageView&, const TGAImageView&);
+
     // Default constructor.
     TGAImage();
 
+    // Constructs a black 24-bit image of the given size. Sizes that are negative, wider or taller than
+    // 32767 (the header keeps them in shorts) or over INT_MAX bytes of pixels give an empty image.
+    TGAImage(int width, int height);
+
+    TGAImage(const TGAImage& other) = default;
+    TGAImage(TGAImage&& other) = default;
+
+    // Replaces the image with another one. The whole image is marked dirty, so a pipeline reading this
+    // image as a source recomputes everything rather than keeping results of the old contents.
+    TGAImage& operator=(const TGAImage& other);
+    TGAImage& operator=(TGAImage&& other);
+
+    // Checks that a width x height 24-bit image can be held: both at least 0, at most 32767, and
+    // width * height * 3 within an int, which pixel offsets are computed in.
+    static bool validDimensions(int width, int height);
+
     // Function to get the width of the image.
     int getWidth() const;
 
@@ -44,6 +142,15 @@ public:
     // Function to set the height of the image.
     void setHeight(int height);
 
+    // Resizes the image to width x height 24-bit pixels with a default header, reusing the current allocation
+    // when it's big enough.
+    // The pixel contents are left unspecified and the whole image is marked dirty. Invalid sizes
+    // (see validDimensions) leave an empty image.
+    void resize(int width, int height);
+
+    // Gets the number of bytes the image can hold without reallocating.
+    size_t getCapacity() const;
+
     // Gets the color data of a pixel at (x,y) coordinate.
     bool getPixelColor(int x, int y, unsigned char& red, unsigned char& green, unsigned char& blue) const;
 
@@ -53,18 +160,97 @@ public:
     // Function to set the bits per pixel of the image.
     void setBitsPerPixel(unsigned char bitsPerPixel);
 
-    // Function to set the color data of a pixel at (x, y) coordinate.
+    // Function to set the color data of a pixel at (x, y) coordinate. Nothing is marked dirty, so loops
+    // of single-pixel writes stay cheap; call markDirty once for the area written.
     bool setPixelColor(int x, int y, unsigned char red, unsigned char green, unsigned char blue);
 
-    // Loads in a TGA file.
+    // Marks a rectangle of the image as changed. Code that writes pixels calls this once per operation
+    // so pipelines know which parts of their results to recompute.
+    void markDirty(int x, int y, int width, int height);
+
+    // Gets the generation of the image's latest edit, 0 if it has none. Generations count up across
+    // every image, so an edit always gets a later generation than anything seen before it.
+    unsigned long long getDirtyGeneration() const;
+
+    // Adds the rectangles edited after the given generation to rects, independently of clearDirty.
+    // Returns false if some of those edits are too old to be remembered, meaning the whole image may have changed.
+    bool getDirtyRectsSince(unsigned long long generation, vector<TGARect>& rects) const;
+
+    // Gets the rectangles that changed since the last clearDirty(). They don't overlap each other.
+    const vector<TGARect>& getDirtyRects() const;
+
+    // Forgets the changed rectangles, usually once every result depending on the image is up to date.
+    void clearDirty();
+
+    // Adds a rectangle to a list of non-overlapping rectangles, merging it with the ones it touches.
+    // Once the list holds more than maxRects rectangles they collapse into their bounding box.
+    static void addRect(vector<TGARect>& rects, const TGARect& rect, int maxRects = 16);
+
+    // Reads the 18-byte TGA header, then skips the ID field and any color map so the stream is left
+    // at the first pixel. Returns false if the stream ends first.
+    static bool readTGAHeader(istream& stream, TGAHeader& header);
+
+    // Checks that loadTGA can load a file with this header: uncompressed true color (type 2), 24 bits per
+    // pixel, and a width and height of at least 1 that validDimensions accepts.
+    static bool canLoadTGA(const TGAHeader& header);
+
+    // Reads just the header of a QOI file if the filename ends in .qoi, otherwise of a TGA file,
+    // to learn an image's size and type without loading its pixels. The fields are what the header says,
+    // and loadable tells whether loadImage would accept it. Returns false if the header can't be read.
+    static bool probeImage(const string& filename, TGAImageInfo& info);
+
+    // Loads in a TGA file. The whole image is marked dirty.
     bool loadTGA(const string& filename);
 
+    // Loads in TGA data from a stream, such as a file or a buffer in memory. Returns false if the header
+    // fails canLoadTGA or the stream ends before every pixel was read.
+    bool loadTGA(istream& stream);
+
     // Saves data to a new TGA file.
     bool saveTGA(const string& filename) const;
 
+    // Writes the image to a stream in TGA format.
+    bool saveTGA(ostream& stream) const;
+
+    // Loads in a QOI file, a lossless format that is much smaller than TGA and nearly as fast to read.
+    bool loadQOI(const string& filename);
+
+    // Loads in QOI data from a stream.
+    bool loadQOI(istream& stream);
+
+    // Saves the image to a new QOI file, encoding it row by row.
+    bool saveQOI(const string& filename) const;
+
+    // Writes the image to a stream in QOI format.
+    bool saveQOI(ostream& stream) const;
+
+    // Loads in a QOI file if the filename ends in .qoi, otherwise a TGA file.
+    bool loadImage(const string& filename);
+
+    // Saves to a QOI file if the filename ends in .qoi, otherwise to a TGA file.
+    bool saveImage(const string& filename) const;
+
     // Prints pixel data.
     void printPixelData() const;
 
+    // Gets a view of the whole image.
+    TGAImageView view();
+    TGAConstImageView view() const;
+
+    // Gets a view of the width x height rectangle whose first pixel is at (x, y).
+    // Returns an empty view if the rectangle doesn't fit inside the image.
+    TGAImageView view(int x, int y, int width, int height);
+    TGAConstImageView view(int x, int y, int width, int height) const;
+
+    // Copies the pixels of a view into a new image.
+    static TGAImage copyView(const TGAConstImageView& source);
+
+    // Crops the width x height rectangle whose first pixel is at (x, y) into a new image.
+    static TGAImage cropImage(const TGAImage& image, int x, int y, int width, int height);
+
+    // Copies the pixels of one view into another view of the same size.
+    static bool copyPixels(const TGAConstImageView& source, const TGAImageView& destination);
+
     // Multiplies two TGAImage objects together.
     static TGAImage multiplyImages(const TGAImage& topLayer, const TGAImage& bottomLayer);
 
@@ -77,12 +263,164 @@ public:
     // Overlays two TGAImage objects together.
     static TGAImage overlayImages(const TGAImage& background, const TGAImage& foreground);
 
+    // Keeps the darker of the two layers for each channel.
+    static TGAImage darkenImages(const TGAImage& topLayer, const TGAImage& bottomLayer);
+
+    // Keeps the lighter of the two layers for each channel.
+    static TGAImage lightenImages(const TGAImage& topLayer, const TGAImage& bottomLayer);
+
+    // Takes the absolute difference between two TGAImage objects.
+    static TGAImage differenceImages(const TGAImage& topLayer, const TGAImage& bottomLayer);
+
+    // Brightens the bottom layer based on the top layer (color dodge).
+    static TGAImage colorDodgeImages(const TGAImage& topLayer, const TGAImage& bottomLayer);
+
+    // Darkens the bottom layer based on the top layer (color burn).
+    static TGAImage colorBurnImages(const TGAImage& topLayer, const TGAImage& bottomLayer);
+
+    // Soft light blends two TGAImage objects together.
+    static TGAImage softLightImages(const TGAImage& topLayer, const TGAImage& bottomLayer);
+
+    // Hard light blends two TGAImage objects together (overlay keyed on the top layer).
+    static TGAImage hardLightImages(const TGAImage& topLayer, const TGAImage& bottomLayer);
+
+    // Adds two TGAImage objects together, saturating at 255.
+    static TGAImage addImages(const TGAImage& topLayer, const TGAImage& bottomLayer);
+
     // Adds 200 to the green channel.
     static TGAImage add200Green(const TGAImage& image);
 
     // Scales the red and blue channels.
     static TGAImage scaleChannels(const TGAImage& image, float redScale, float blueScale);
 
+    // View versions of the blend and adjust operations. They write into a result view of the same size,
+    // which may be one of the inputs, and return false on a dimension mismatch.
+    static bool multiplyImages(const TGAConstImageView& topLayer, const TGAConstImageView& bottomLayer, const TGAImageView& result);
+    static bool subtractImages(const TGAConstImageView& topLayer, const TGAConstImageView& bottomLayer, const TGAImageView& result);
+    static bool screenImages(const TGAConstImageView& topLayer, const TGAConstImageView& bottomLayer, const TGAImageView& result);
+    static bool overlayImages(const TGAConstImageView& background, const TGAConstImageView& foreground, const TGAImageView& result);
+    static bool darkenImages(const TGAConstImageView& topLayer, const TGAConstImageView& bottomLayer, const TGAImageView& result);
+    static bool lightenImages(const TGAConstImageView& topLayer, const TGAConstImageView& bottomLayer, const TGAImageView& result);
+    static bool differenceImages(const TGAConstImageView& topLayer, const TGAConstImageView& bottomLayer, const TGAImageView& result);
+    static bool colorDodgeImages(const TGAConstImageView& topLayer, const TGAConstImageView& bottomLayer, const TGAImageView& result);
+    static bool colorBurnImages(const TGAConstImageView& topLayer, const TGAConstImageView& bottomLayer, const TGAImageView& result);
+    static bool softLightImages(const TGAConstImageView& topLayer, const TGAConstImageView& bottomLayer, const TGAImageView& result);
+    static bool hardLightImages(const TGAConstImageView& topLayer, const TGAConstImageView& bottomLayer, const TGAImageView& result);
+    static bool addImages(const TGAConstImageView& topLayer, const TGAConstImageView& bottomLayer, const TGAImageView& result);
+    static bool add200Green(const TGAConstImageView& image, const TGAImageView& result);
+    static bool scaleChannels(const TGAConstImageView& image, float redScale, float blueScale, const TGAImageView& result);
+    static bool separateChannels(const TGAConstImageView& image, const TGAImageView& redResult,
+                                 const TGAImageView& greenResult, const TGAImageView& blueResult);
+    static bool combineChannels(const TGAConstImageView& layerRed, const TGAConstImageView& layerGreen,
+                                const TGAConstImageView& layerBlue, const TGAImageView& result);
+    static bool flipImage180(const TGAConstImageView& image, const TGAImageView& result);
+
+    // Applies a color matrix to every pixel. Weights are clamped to [-256, 256] and offsets to [-1024, 1024]
+    // before use. Pure swizzles and matrices with no cross-channel weights are detected and run as byte
+    // shuffles and exactly rounded per-channel lookup tables, anything else with 12-bit fixed-point weights,
+    // which can round one level differently from exact arithmetic. Multi-threaded over rows, and the view
+    // version may work in place.
+    static TGAImage colorMatrix(const TGAImage& image, const TGAColorMatrix& matrix);
+    static bool colorMatrix(const TGAConstImageView& image, const TGAColorMatrix& matrix, const TGAImageView& result);
+
+    // Color space conversions. Planar outputs hold one value per pixel in the same order as imageData.
+    // All of them use integer fixed-point math and run multi-threaded over rows.
+
+    // Converts to grayscale with the given luma weights, the gray value goes in all three channels.
+    static TGAImage toGrayscale(const TGAImage& image, LumaStandard standard = Rec601);
+
+    // Converts to a plane of luma values.
+    static void toGrayscale(const TGAImage& image, vector<unsigned char>& gray, LumaStandard standard = Rec601);
+
+    // Converts to full-range (JPEG) YCbCr planes. Converting back with fromYCbCr is off by at most
+    // 1 per channel; 24% of all 2^24 colors come back exactly, as 8-bit YCbCr can't hold every RGB color.
+    static void toYCbCr(const TGAImage& image, vector<unsigned char>& luma, vector<unsigned char>& blueDifference,
+                        vector<unsigned char>& redDifference);
+
+    // Builds an image from full-range YCbCr planes.
+    static TGAImage fromYCbCr(const vector<unsigned char>& luma, const vector<unsigned char>& blueDifference,
+                              const vector<unsigned char>& redDifference, int width, int height);
+
+    // Converts to HSV planes. Hue runs from 0 to 1535 (256 steps for each 60 degree sector),
+    // saturation and value from 0 to 255. Converting back with fromHSV is off by at most
+    // 1 per channel, and 81% of all 2^24 colors come back exactly.
+    static void toHSV(const TGAImage& image, vector<unsigned short>& hue, vector<unsigned char>& saturation,
+                      vector<unsigned char>& value);
+
+    // Builds an image from HSV planes.
+    static TGAImage fromHSV(const vector<unsigned short>& hue, const vector<unsigned char>& saturation,
+                            const vector<unsigned char>& value, int width, int height);
+
+    // Converts to HSL planes, with hue as in toHSV and saturation and lightness from 0 to 255.
+    // Converting back with fromHSL is off by at most 2 per channel, and 48% of all 2^24 colors come back exactly.
+    static void toHSL(const TGAImage& image, vector<unsigned short>& hue, vector<unsigned char>& saturation,
+                      vector<unsigned char>& lightness);
+
+    // Builds an image from HSL planes.
+    static TGAImage fromHSL(const vector<unsigned short>& hue, const vector<unsigned char>& saturation,
+                            const vector<unsigned char>& lightness, int width, int height);
+
+    // Shifts the hue (in degrees) and scales the HSV saturation and brightness of every pixel in one pass,
+    // without building intermediate planes. With no change it is the HSV round trip, off by at most 1.
+    static TGAImage adjustHSB(const TGAImage& image, float hueShift, float saturationScale, float brightnessScale);
+
+    // Morphology with a (2 * radiusX + 1) x (2 * radiusY + 1) rectangle, applied to each channel on its own.
+    // Uses the van Herk/Gil-Werman algorithm as a horizontal then a vertical pass, so the cost per pixel
+    // is the same for any radius. Pixels outside the image are ignored. Multi-threaded.
+
+    // Takes the minimum of each rectangle, shrinking light areas.
+    static TGAImage erodeImage(const TGAImage& image, int radiusX, int radiusY);
+
+    // Takes the maximum of each rectangle, growing light areas.
+    static TGAImage dilateImage(const TGAImage& image, int radiusX, int radiusY);
+
+    // Erodes and then dilates, removing light specks smaller than the rectangle.
+    static TGAImage openImage(const TGAImage& image, int radiusX, int radiusY);
+
+    // Dilates and then erodes, filling dark holes smaller than the rectangle.
+    static TGAImage closeImage(const TGAImage& image, int radiusX, int radiusY);
+
+    // Mask versions, for planes of width x height 8-bit values such as toGrayscale fills.
+    // They return false if the mask isn't width x height.
+    static bool erodeMask(const vector<unsigned char>& mask, int width, int height, int radiusX, int radiusY,
+                          vector<unsigned char>& result);
+    static bool dilateMask(const vector<unsigned char>& mask, int width, int height, int radiusX, int radiusY,
+                           vector<unsigned char>& result);
+    static bool openMask(const vector<unsigned char>& mask, int width, int height, int radiusX, int radiusY,
+                         vector<unsigned char>& result);
+    static bool closeMask(const vector<unsigned char>& mask, int width, int height, int radiusX, int radiusY,
+                          vector<unsigned char>& result);
+
+    // Reductions over any number of equally sized layers, computed per channel in one pass. Every layer is
+    // read a tile at a time and the tiles are spread over threads, so stacking N layers costs one pass
+    // instead of N - 1 chained blends. They return an empty image if there are no layers or sizes differ.
+
+    // Rounded mean of up to 16777215 (2^24 - 1) layers, so the per-value sums fit in 32 bits.
+    static TGAImage meanImages(const vector<const TGAImage*>& layers);
+
+    // Median of the layers, the upper middle value for an even count. Uses a sorting network run across
+    // whole tiles, pruned to the comparisons the middle value depends on.
+    static TGAImage medianImages(const vector<const TGAImage*>& layers);
+
+    // Median of the layers into an existing image, reusing its buffer when it's big enough. The result
+    // can't be one of the layers. Returns false and leaves the result empty if the layers don't match.
+    static bool medianImages(const vector<const TGAImage*>& layers, TGAImage& result);
+
+    // Darkest and lightest value of the layers.
+    static TGAImage minImages(const vector<const TGAImage*>& layers);
+    static TGAImage maxImages(const vector<const TGAImage*>& layers);
+
+    // Sum of the layers, saturating at 255.
+    static TGAImage sumImages(const vector<const TGAImage*>& layers);
+
+    // Average weighted by one non-negative weight per layer. The weights don't need to add up to 1.
+    static TGAImage weightedAverageImages(const vector<const TGAImage*>& layers, const vector<float>& weights);
+
+    // Looks up the view version of a blend operation by its short name ("multiply", "subtract", "screen",
+    // "overlay", "darken", "lighten", "difference", "colordodge", "colorburn", "softlight", "hardlight"
+    // or "add"). Returns nullptr for an unknown name.
+    static BlendFunction findBlend(const string& name);
+
     // Separates rgb channels and outputs them as separate files.
     static bool separateChannels(const TGAImage& image, const string& redFilename, 
                                  const string& greenFilename, const string& blueFilename);
@@ -94,11 +432,31 @@ public:
     // Flips an image 180 degrees.
     static TGAImage flipImage180(const TGAImage& image);
 
-    /*
+    // Builds every power-of-two level of an image, from the image itself (level 0) down to 1x1.
+    static vector<TGAImage> buildPyramid(const TGAImage& image);
+
+    // Builds the pyramid of an image and saves each level as <baseFilename>_level<N>.tga.
+    static bool savePyramid(const TGAImage& image, const string& baseFilename);
+
     // Makes a 2x2 grid image out of 4 images.
     static TGAImage gridImage(const TGAImage& bottomLeftImage, const TGAImage& bottomRightImage,
                               const TGAImage& topLeftImage, const TGAImage& topRightImage);
-    */
+
+private:
+    // Checks that the width x height rectangle at (x, y) is inside the image and its pixels are allocated.
+    bool viewFits(int x, int y, int width, int height) const;
+
+    // Fills rows [firstRow, endRow) of a half-size level with 2x2 box-filtered pixels of the level above.
+    static void downsampleRows(const TGAImage& source, TGAImage& level, int firstRow, int endRow);
+
+    // Applies a per-channel blend functor to every byte of two equally sized views.
+    // BlendOp::apply(first, second) is inlined into the loop, so each mode gets its own compiled kernel.
+    template <typename BlendOp>
+    static bool blendViews(const TGAConstImageView& first, const TGAConstImageView& second, const TGAImageView& result);
+
+    // Image version of blendViews, allocating the result.
+    template <typename BlendOp>
+    static TGAImage blendImages(const TGAImage& first, const TGAImage& second);
 };
 
 #endif // TGA_Image_H
@@ -0,0 +1,250 @@
+#include "TGAImageC.h"
+#include "TGAImage.h"
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+#include <sstream>
+#include <streambuf>
+using namespace std;
+
+// Exceptions must not cross into C callers, so every entry point that can allocate or do I/O catches
+// them and reports failure instead. The plain getters and frees can't throw.
+
+// The C handle is the C++ image itself.
+struct tga_image {
+    TGAImage image;
+};
+
+namespace {
+
+// Read-only stream buffer over memory owned by the caller, so decoding doesn't copy the data first.
+class MemoryBuffer : public streambuf {
+public:
+    MemoryBuffer(const unsigned char* data, size_t size) {
+        char* begin = const_cast<char*>(reinterpret_cast<const char*>(data));
+        setg(begin, begin, begin + size);
+    }
+};
+
+// Wraps a result image in a new handle, or returns NULL if the operation failed and left it empty.
+tga_image* wrapResult(TGAImage result) {
+    if (result.getWidth() == 0 || result.getHeight() == 0) {
+        return NULL;
+    }
+    tga_image* handle = new (nothrow) tga_image;
+    if (handle != NULL) {
+        handle->image = move(result);
+    }
+    return handle;
+};
+
+}
+
+tga_image* tga_image_create(int width, int height) {
+    try {
+        if (width <= 0 || height <= 0 || width > 32767 || height > 32767) {
+            return NULL;
+        }
+        return wrapResult(TGAImage(width, height));
+    } catch (...) {
+        return NULL;
+    }
+};
+
+void tga_image_free(tga_image* image) {
+    delete image;
+};
+
+int tga_image_width(const tga_image* image) {
+    return image->image.getWidth();
+};
+
+int tga_image_height(const tga_image* image) {
+    return image->image.getHeight();
+};
+
+unsigned char* tga_image_pixels(tga_image* image) {
+    return image->image.view().data;
+};
+
+tga_image* tga_image_load(const char* filename) {
+    try {
+        TGAImage result;
+        if (!result.loadImage(filename)) {
+            return NULL;
+        }
+        return wrapResult(move(result));
+    } catch (...) {
+        return NULL;
+    }
+};
+
+int tga_image_probe(const char* filename, int* width, int* height, int* bitsPerPixel) {
+    try {
+        TGAImageInfo info;
+        if (!TGAImage::probeImage(filename, info) || !info.loadable) {
+            return 0;
+        }
+        if (width != NULL) {
+            *width = info.width;
+        }
+        if (height != NULL) {
+            *height = info.height;
+        }
+        if (bitsPerPixel != NULL) {
+            *bitsPerPixel = info.bitsPerPixel;
+        }
+        return 1;
+    } catch (...) {
+        return 0;
+    }
+};
+
+int tga_image_save(const tga_image* image, const char* filename) {
+    try {
+        return image->image.saveImage(filename) ? 1 : 0;
+    } catch (...) {
+        return 0;
+    }
+};
+
+tga_image* tga_image_load_memory(const unsigned char* data, size_t size) {
+    try {
+        MemoryBuffer buffer(data, size);
+        istream stream(&buffer);
+
+        TGAImage result;
+        bool isQOI = size >= 4 && memcmp(data, "qoif", 4) == 0;
+        if (!(isQOI ? result.loadQOI(stream) : result.loadTGA(stream))) {
+            return NULL;
+        }
+        return wrapResult(move(result));
+    } catch (...) {
+        return NULL;
+    }
+};
+
+int tga_image_save_memory(const tga_image* image, enum tga_format format, unsigned char** data, size_t* size) {
+    try {
+        ostringstream stream(ios_base::out | ios_base::binary);
+        bool saved = format == TGA_FORMAT_QOI ? image->image.saveQOI(stream) : image->image.saveTGA(stream);
+        if (!saved) {
+            return 0;
+        }
+
+        // Copies into a malloc'd buffer so C callers can free it without knowing about std::string.
+        string encoded = stream.str();
+        *data = static_cast<unsigned char*>(malloc(encoded.size()));
+        if (*data == NULL) {
+            return 0;
+        }
+        memcpy(*data, encoded.data(), encoded.size());
+        *size = encoded.size();
+        return 1;
+    } catch (...) {
+        return 0;
+    }
+};
+
+void tga_buffer_free(unsigned char* data) {
+    free(data);
+};
+
+tga_image* tga_blend(const char* mode, const tga_image* top, const tga_image* bottom) {
+    try {
+        TGAImage::BlendFunction blend = TGAImage::findBlend(mode);
+        if (blend == nullptr || top->image.getWidth() != bottom->image.getWidth() ||
+            top->image.getHeight() != bottom->image.getHeight()) {
+            return NULL;
+        }
+
+        TGAImage result(top->image.getWidth(), top->image.getHeight());
+        if (!blend(top->image.view(), bottom->image.view(), result.view())) {
+            return NULL;
+        }
+        return wrapResult(move(result));
+    } catch (...) {
+        return NULL;
+    }
+};
+
+int tga_blend_buffers(const char* mode, const unsigned char* top, int topStride, const unsigned char* bottom,
+                      int bottomStride, unsigned char* result, int resultStride, int width, int height) {
+    // The views trust their pointers and strides, so check them here. Offsets are computed as y * stride
+    // in an int, which the last check keeps in range.
+    if (mode == NULL || top == NULL || bottom == NULL || result == NULL || width <= 0 || height <= 0 ||
+        !TGAImage::validDimensions(width, height)) {
+        return 0;
+    }
+    int strides[3] = { topStride, bottomStride, resultStride };
+    for (int i = 0; i < 3; ++i) {
+        if (strides[i] < width * 3 || static_cast<long long>(strides[i]) * height > INT_MAX) {
+            return 0;
+        }
+    }
+
+    try {
+        TGAImage::BlendFunction blend = TGAImage::findBlend(mode);
+        if (blend == nullptr) {
+            return 0;
+        }
+
+        TGAImageView resultView = { result, width, height, resultStride };
+        return blend(TGAConstImageView(top, width, height, topStride),
+                     TGAConstImageView(bottom, width, height, bottomStride), resultView) ? 1 : 0;
+    } catch (...) {
+        return 0;
+    }
+};
+
+tga_image* tga_add_200_green(const tga_image* image) {
+    try {
+        return wrapResult(TGAImage::add200Green(image->image));
+    } catch (...) {
+        return NULL;
+    }
+};
+
+tga_image* tga_scale_channels(const tga_image* image, float redScale, float blueScale) {
+    try {
+        return wrapResult(TGAImage::scaleChannels(image->image, redScale, blueScale));
+    } catch (...) {
+        return NULL;
+    }
+};
+
+tga_image* tga_adjust_hsb(const tga_image* image, float hueShift, float saturationScale, float brightnessScale) {
+    try {
+        return wrapResult(TGAImage::adjustHSB(image->image, hueShift, saturationScale, brightnessScale));
+    } catch (...) {
+        return NULL;
+    }
+};
+
+tga_image* tga_grayscale(const tga_image* image) {
+    try {
+        return wrapResult(TGAImage::toGrayscale(image->image));
+    } catch (...) {
+        return NULL;
+    }
+};
+
+tga_image* tga_flip_180(const tga_image* image) {
+    try {
+        return wrapResult(TGAImage::flipImage180(image->image));
+    } catch (...) {
+        return NULL;
+    }
+};
+
+tga_image* tga_color_matrix(const tga_image* image, const float matrix[12]) {
+    try {
+        TGAColorMatrix colorMatrix;
+        memcpy(colorMatrix.m, matrix, sizeof(colorMatrix.m));
+        return wrapResult(TGAImage::colorMatrix(image->image, colorMatrix));
+    } catch (...) {
+        return NULL;
+    }
+};
@@ -0,0 +1,89 @@
+#ifndef TGA_IMAGE_C_H
+#define TGA_IMAGE_C_H
+
+/*
+ * Plain C interface to libtgaimage, for embedding the image operations in other programs and languages.
+ *
+ * Pixels are 24-bit, stored in BGR order with the first row at the bottom of the image, and rows
+ * follow each other with no padding (stride = width * 3). tga_image_pixels gives direct access to an
+ * image's pixels, and tga_blend_buffers works on memory owned by the caller, so pixel data can be
+ * shared across a language boundary without copying.
+ *
+ * Functions returning a pointer return NULL on failure, functions returning int return 1 on success
+ * and 0 on failure.
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Opaque handle to an image. */
+typedef struct tga_image tga_image;
+
+/* File formats for tga_image_save_memory. */
+enum tga_format {
+    TGA_FORMAT_TGA = 0,
+    TGA_FORMAT_QOI = 1
+};
+
+/* Creates a black width x height image. */
+tga_image* tga_image_create(int width, int height);
+
+/* Frees an image. Passing NULL does nothing. */
+void tga_image_free(tga_image* image);
+
+int tga_image_width(const tga_image* image);
+int tga_image_height(const tga_image* image);
+
+/* Gets the image's pixels. The pointer stays valid until the image is freed. */
+unsigned char* tga_image_pixels(tga_image* image);
+
+/* Loads a TGA or QOI file, chosen by the .qoi extension. */
+tga_image* tga_image_load(const char* filename);
+
+/* Reads just the header of a TGA or QOI file, chosen by the .qoi extension, without loading its pixels.
+   Returns 0 if the header can't be read or tga_image_load couldn't load the file. Any of the output
+   pointers may be NULL. */
+int tga_image_probe(const char* filename, int* width, int* height, int* bitsPerPixel);
+
+/* Saves to a TGA or QOI file, chosen by the .qoi extension. */
+int tga_image_save(const tga_image* image, const char* filename);
+
+/* Decodes a TGA or QOI file held in memory, recognising QOI by its magic bytes. The data isn't copied first. */
+tga_image* tga_image_load_memory(const unsigned char* data, size_t size);
+
+/* Encodes an image into a new buffer, which the caller frees with tga_buffer_free. */
+int tga_image_save_memory(const tga_image* image, enum tga_format format, unsigned char** data, size_t* size);
+
+/* Frees a buffer returned by tga_image_save_memory. */
+void tga_buffer_free(unsigned char* data);
+
+/* Blends two equally sized images into a new one. The mode is a blend name such as "multiply",
+   "subtract", "screen", "overlay", "darken", "lighten", "difference", "colordodge", "colorburn",
+   "softlight", "hardlight" or "add". */
+tga_image* tga_blend(const char* mode, const tga_image* top, const tga_image* bottom);
+
+/* Blends width x height pixels of caller-owned buffers, each with its own stride in bytes.
+   The result may be one of the inputs. Returns 0 for a NULL pointer, a size of 0 or less or one
+   tga_image can't hold, or a stride smaller than width * 3. */
+int tga_blend_buffers(const char* mode, const unsigned char* top, int topStride, const unsigned char* bottom,
+                      int bottomStride, unsigned char* result, int resultStride, int width, int height);
+
+/* Adjustments, each returning a new image. */
+tga_image* tga_add_200_green(const tga_image* image);
+tga_image* tga_scale_channels(const tga_image* image, float redScale, float blueScale);
+tga_image* tga_adjust_hsb(const tga_image* image, float hueShift, float saturationScale, float brightnessScale);
+tga_image* tga_grayscale(const tga_image* image);
+tga_image* tga_flip_180(const tga_image* image);
+
+/* Applies a 3x4 color matrix, given row by row: each of the output red, green and blue rows holds the
+   weights of the input red, green and blue followed by an offset in 0-255 units. Results saturate. */
+tga_image* tga_color_matrix(const tga_image* image, const float matrix[12]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TGA_IMAGE_C_H */
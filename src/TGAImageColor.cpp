@@ -0,0 +1,512 @@
+#include "TGAImage.h"
+#include "Parallel.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+using namespace std;
+
+// Color space conversions and color matrices for TGAImage. Every kernel works on one pixel with integer math
+// only (fixed-point weights), so the per-row loops have no calls or floating point in them.
+namespace {
+
+// Clamps a value to the range [0, 255].
+inline unsigned char clampByte(int value) {
+    return static_cast<unsigned char>(value < 0 ? 0 : (value > 255 ? 255 : value));
+};
+
+// Divides by a positive divisor, rounding to nearest with halves away from zero.
+inline int roundedDivide(int numerator, int divisor) {
+    return numerator >= 0 ? (numerator + divisor / 2) / divisor : -((-numerator + divisor / 2) / divisor);
+};
+
+// Luma weights scaled by 65536, in red, green, blue order. Each row sums to 65536.
+const int LUMA_WEIGHTS[2][3] = {
+    { 19595, 38470, 7471 },  // Rec. 601: 0.299, 0.587, 0.114
+    { 13933, 46871, 4732 }   // Rec. 709: 0.2126, 0.7152, 0.0722
+};
+
+// Weighted sum of the channels, rounded.
+inline unsigned char luma(int red, int green, int blue, const int* weights) {
+    return static_cast<unsigned char>((weights[0] * red + weights[1] * green + weights[2] * blue + 32768) >> 16);
+};
+
+// Full-range BT.601 YCbCr, as used by JPEG.
+inline void rgbToYCbCr(int red, int green, int blue, unsigned char& y, unsigned char& cb, unsigned char& cr) {
+    y = luma(red, green, blue, LUMA_WEIGHTS[0]);
+    cb = clampByte((-11059 * red - 21709 * green + 32768 * blue + (128 << 16) + 32768) >> 16);
+    cr = clampByte((32768 * red - 27439 * green - 5329 * blue + (128 << 16) + 32768) >> 16);
+};
+
+inline void yCbCrToRgb(int y, int cb, int cr, unsigned char& red, unsigned char& green, unsigned char& blue) {
+    // The offset keeps the sums positive so the shift rounds the same way for every value.
+    const int offset = (256 << 16) + 32768;
+    cb -= 128;
+    cr -= 128;
+    red = clampByte((((y << 16) + 91881 * cr + offset) >> 16) - 256);
+    green = clampByte((((y << 16) - 22554 * cb - 46802 * cr + offset) >> 16) - 256);
+    blue = clampByte((((y << 16) + 116130 * cb + offset) >> 16) - 256);
+};
+
+// Hue of a color in 1/256ths of a 60 degree sector (0 to 1535), shared by HSV and HSL.
+inline unsigned short hueOf(int red, int green, int blue, int maximum, int delta) {
+    if (delta == 0) {
+        return 0;
+    }
+
+    int hue;
+    if (maximum == red) {
+        hue = roundedDivide(256 * (green - blue), delta);
+    } else if (maximum == green) {
+        hue = 512 + roundedDivide(256 * (blue - red), delta);
+    } else {
+        hue = 1024 + roundedDivide(256 * (red - green), delta);
+    }
+    return static_cast<unsigned short>(hue < 0 ? hue + 1536 : hue);
+};
+
+// Builds a color from its hue, chroma (in half steps) and the amount added to every channel (in quarter steps).
+// The extra precision keeps HSL's half-chroma offset from rounding twice.
+inline void hueToRgb(int hue, int chroma2, int offset4, unsigned char& red, unsigned char& green, unsigned char& blue) {
+    int sector = hue >> 8;
+    int fraction = hue & 255;
+
+    // The second largest channel rises through even sectors and falls through odd ones.
+    int second2 = (chroma2 * ((sector & 1) ? 256 - fraction : fraction) + 128) >> 8;
+
+    int r2, g2, b2;
+    switch (sector) {
+        case 0:  r2 = chroma2; g2 = second2; b2 = 0;       break;
+        case 1:  r2 = second2; g2 = chroma2; b2 = 0;       break;
+        case 2:  r2 = 0;       g2 = chroma2; b2 = second2; break;
+        case 3:  r2 = 0;       g2 = second2; b2 = chroma2; break;
+        case 4:  r2 = second2; g2 = 0;       b2 = chroma2; break;
+        default: r2 = chroma2; g2 = 0;       b2 = second2; break;
+    }
+
+    red = clampByte((2 * r2 + offset4 + 2) >> 2);
+    green = clampByte((2 * g2 + offset4 + 2) >> 2);
+    blue = clampByte((2 * b2 + offset4 + 2) >> 2);
+};
+
+inline void rgbToHsv(int red, int green, int blue, unsigned short& hue, unsigned char& saturation, unsigned char& value) {
+    int maximum = max(red, max(green, blue));
+    int delta = maximum - min(red, min(green, blue));
+
+    hue = hueOf(red, green, blue, maximum, delta);
+    saturation = static_cast<unsigned char>(maximum == 0 ? 0 : (255 * delta + maximum / 2) / maximum);
+    value = static_cast<unsigned char>(maximum);
+};
+
+inline void hsvToRgb(int hue, int saturation, int value, unsigned char& red, unsigned char& green, unsigned char& blue) {
+    // Chroma = V * S, the lowest channel is V - chroma.
+    int chroma2 = (2 * value * saturation + 127) / 255;
+    hueToRgb(hue, chroma2, 4 * value - 2 * chroma2, red, green, blue);
+};
+
+inline void rgbToHsl(int red, int green, int blue, unsigned short& hue, unsigned char& saturation, unsigned char& lightness) {
+    int maximum = max(red, max(green, blue));
+    int minimum = min(red, min(green, blue));
+    int delta = maximum - minimum;
+    int sum = maximum + minimum;
+
+    // Saturation is chroma relative to the most chroma possible at this lightness.
+    int range = sum <= 255 ? sum : 510 - sum;
+    hue = hueOf(red, green, blue, maximum, delta);
+    saturation = static_cast<unsigned char>(delta == 0 ? 0 : min(255, (255 * delta + range / 2) / range));
+    lightness = static_cast<unsigned char>((sum + 1) >> 1);
+};
+
+inline void hslToRgb(int hue, int saturation, int lightness, unsigned char& red, unsigned char& green, unsigned char& blue) {
+    // Chroma = (1 - |2L - 1|) * S, centred on the lightness.
+    int range = 255 - abs(2 * lightness - 255);
+    int chroma2 = (2 * range * saturation + 127) / 255;
+    hueToRgb(hue, chroma2, 4 * lightness - chroma2, red, green, blue);
+};
+
+// Color matrix weights and offsets are scaled by 4096. Weights are clamped to +-256 so a full row of them
+// times 255 still fits in an int.
+const int MATRIX_SHIFT = 12;
+
+inline int matrixFixed(float value, float limit) {
+    value = max(-limit, min(limit, value));
+    return static_cast<int>(floor(value * (1 << MATRIX_SHIFT) + 0.5f));
+};
+
+// Weighted sum of the channels plus the offset, rounded and saturated.
+inline unsigned char matrixRow(const int* row, int red, int green, int blue) {
+    return clampByte((row[0] * red + row[1] * green + row[2] * blue + row[3] + (1 << (MATRIX_SHIFT - 1))) >> MATRIX_SHIFT);
+};
+
+}
+
+// Converts to grayscale, with the gray value in all three channels.
+TGAImage TGAImage::toGrayscale(const TGAImage& image, LumaStandard standard) {
+    TGAImage resultImage = image;
+    const int* weights = LUMA_WEIGHTS[standard == Rec709 ? 1 : 0];
+    const unsigned char* source = image.imageData.data();
+    unsigned char* destination = resultImage.imageData.data();
+    int width = image.getWidth();
+
+    parallelRows(image.getHeight(), [=](int firstRow, int endRow) {
+        for (int i = firstRow * width * 3; i < endRow * width * 3; i += 3) {
+            unsigned char gray = luma(source[i + 2], source[i + 1], source[i], weights);
+            destination[i] = gray;
+            destination[i + 1] = gray;
+            destination[i + 2] = gray;
+        }
+    });
+
+    return resultImage;
+};
+
+// Converts to a plane of luma values.
+void TGAImage::toGrayscale(const TGAImage& image, vector<unsigned char>& gray, LumaStandard standard) {
+    gray.resize(image.getWidth() * image.getHeight());
+    const int* weights = LUMA_WEIGHTS[standard == Rec709 ? 1 : 0];
+    const unsigned char* source = image.imageData.data();
+    unsigned char* destination = gray.data();
+    int width = image.getWidth();
+
+    parallelRows(image.getHeight(), [=](int firstRow, int endRow) {
+        for (int i = firstRow * width; i < endRow * width; ++i) {
+            destination[i] = luma(source[i * 3 + 2], source[i * 3 + 1], source[i * 3], weights);
+        }
+    });
+};
+
+// Converts to full-range YCbCr planes.
+void TGAImage::toYCbCr(const TGAImage& image, vector<unsigned char>& luma, vector<unsigned char>& blueDifference,
+                       vector<unsigned char>& redDifference) {
+    int pixelCount = image.getWidth() * image.getHeight();
+    luma.resize(pixelCount);
+    blueDifference.resize(pixelCount);
+    redDifference.resize(pixelCount);
+
+    const unsigned char* source = image.imageData.data();
+    unsigned char* y = luma.data();
+    unsigned char* cb = blueDifference.data();
+    unsigned char* cr = redDifference.data();
+    int width = image.getWidth();
+
+    parallelRows(image.getHeight(), [=](int firstRow, int endRow) {
+        for (int i = firstRow * width; i < endRow * width; ++i) {
+            rgbToYCbCr(source[i * 3 + 2], source[i * 3 + 1], source[i * 3], y[i], cb[i], cr[i]);
+        }
+    });
+};
+
+// Builds an image from full-range YCbCr planes.
+TGAImage TGAImage::fromYCbCr(const vector<unsigned char>& luma, const vector<unsigned char>& blueDifference,
+                             const vector<unsigned char>& redDifference, int width, int height) {
+    size_t pixelCount = static_cast<size_t>(width) * height;
+    if (luma.size() != pixelCount || blueDifference.size() != pixelCount || redDifference.size() != pixelCount) {
+        cout << "Error: Plane sizes don't match the image dimensions." << endl;
+        return TGAImage();
+    }
+
+    TGAImage resultImage(width, height);
+    const unsigned char* y = luma.data();
+    const unsigned char* cb = blueDifference.data();
+    const unsigned char* cr = redDifference.data();
+    unsigned char* destination = resultImage.imageData.data();
+
+    parallelRows(height, [=](int firstRow, int endRow) {
+        for (int i = firstRow * width; i < endRow * width; ++i) {
+            yCbCrToRgb(y[i], cb[i], cr[i], destination[i * 3 + 2], destination[i * 3 + 1], destination[i * 3]);
+        }
+    });
+
+    return resultImage;
+};
+
+// Converts to HSV planes.
+void TGAImage::toHSV(const TGAImage& image, vector<unsigned short>& hue, vector<unsigned char>& saturation,
+                     vector<unsigned char>& value) {
+    int pixelCount = image.getWidth() * image.getHeight();
+    hue.resize(pixelCount);
+    saturation.resize(pixelCount);
+    value.resize(pixelCount);
+
+    const unsigned char* source = image.imageData.data();
+    unsigned short* h = hue.data();
+    unsigned char* s = saturation.data();
+    unsigned char* v = value.data();
+    int width = image.getWidth();
+
+    parallelRows(image.getHeight(), [=](int firstRow, int endRow) {
+        for (int i = firstRow * width; i < endRow * width; ++i) {
+            rgbToHsv(source[i * 3 + 2], source[i * 3 + 1], source[i * 3], h[i], s[i], v[i]);
+        }
+    });
+};
+
+// Builds an image from HSV planes.
+TGAImage TGAImage::fromHSV(const vector<unsigned short>& hue, const vector<unsigned char>& saturation,
+                           const vector<unsigned char>& value, int width, int height) {
+    size_t pixelCount = static_cast<size_t>(width) * height;
+    if (hue.size() != pixelCount || saturation.size() != pixelCount || value.size() != pixelCount) {
+        cout << "Error: Plane sizes don't match the image dimensions." << endl;
+        return TGAImage();
+    }
+
+    TGAImage resultImage(width, height);
+    const unsigned short* h = hue.data();
+    const unsigned char* s = saturation.data();
+    const unsigned char* v = value.data();
+    unsigned char* destination = resultImage.imageData.data();
+
+    parallelRows(height, [=](int firstRow, int endRow) {
+        for (int i = firstRow * width; i < endRow * width; ++i) {
+            hsvToRgb(h[i] % 1536, s[i], v[i], destination[i * 3 + 2], destination[i * 3 + 1], destination[i * 3]);
+        }
+    });
+
+    return resultImage;
+};
+
+// Converts to HSL planes.
+void TGAImage::toHSL(const TGAImage& image, vector<unsigned short>& hue, vector<unsigned char>& saturation,
+                     vector<unsigned char>& lightness) {
+    int pixelCount = image.getWidth() * image.getHeight();
+    hue.resize(pixelCount);
+    saturation.resize(pixelCount);
+    lightness.resize(pixelCount);
+
+    const unsigned char* source = image.imageData.data();
+    unsigned short* h = hue.data();
+    unsigned char* s = saturation.data();
+    unsigned char* l = lightness.data();
+    int width = image.getWidth();
+
+    parallelRows(image.getHeight(), [=](int firstRow, int endRow) {
+        for (int i = firstRow * width; i < endRow * width; ++i) {
+            rgbToHsl(source[i * 3 + 2], source[i * 3 + 1], source[i * 3], h[i], s[i], l[i]);
+        }
+    });
+};
+
+// Builds an image from HSL planes.
+TGAImage TGAImage::fromHSL(const vector<unsigned short>& hue, const vector<unsigned char>& saturation,
+                           const vector<unsigned char>& lightness, int width, int height) {
+    size_t pixelCount = static_cast<size_t>(width) * height;
+    if (hue.size() != pixelCount || saturation.size() != pixelCount || lightness.size() != pixelCount) {
+        cout << "Error: Plane sizes don't match the image dimensions." << endl;
+        return TGAImage();
+    }
+
+    TGAImage resultImage(width, height);
+    const unsigned short* h = hue.data();
+    const unsigned char* s = saturation.data();
+    const unsigned char* l = lightness.data();
+    unsigned char* destination = resultImage.imageData.data();
+
+    parallelRows(height, [=](int firstRow, int endRow) {
+        for (int i = firstRow * width; i < endRow * width; ++i) {
+            hslToRgb(h[i] % 1536, s[i], l[i], destination[i * 3 + 2], destination[i * 3 + 1], destination[i * 3]);
+        }
+    });
+
+    return resultImage;
+};
+
+// Shifts the hue and scales the saturation and brightness of every pixel in one pass.
+TGAImage TGAImage::adjustHSB(const TGAImage& image, float hueShift, float saturationScale, float brightnessScale) {
+    TGAImage resultImage = image;
+
+    // Hue shift in 1/256ths of a sector wrapped into [0, 1536), the scales as 8.8 fixed point.
+    int hueOffset = static_cast<int>(floor(fmod(hueShift, 360.0f) / 60.0f * 256.0f + 0.5f));
+    hueOffset = ((hueOffset % 1536) + 1536) % 1536;
+    int saturationFactor = static_cast<int>(max(0.0f, saturationScale) * 256.0f + 0.5f);
+    int brightnessFactor = static_cast<int>(max(0.0f, brightnessScale) * 256.0f + 0.5f);
+
+    const unsigned char* source = image.imageData.data();
+    unsigned char* destination = resultImage.imageData.data();
+    int width = image.getWidth();
+
+    parallelRows(image.getHeight(), [=](int firstRow, int endRow) {
+        for (int i = firstRow * width * 3; i < endRow * width * 3; i += 3) {
+            unsigned short hue;
+            unsigned char saturation, value;
+            rgbToHsv(source[i + 2], source[i + 1], source[i], hue, saturation, value);
+
+            int newHue = hue + hueOffset;
+            int newSaturation = min(255, (saturation * saturationFactor + 128) >> 8);
+            int newValue = min(255, (value * brightnessFactor + 128) >> 8);
+            hsvToRgb(newHue >= 1536 ? newHue - 1536 : newHue, newSaturation, newValue,
+                     destination[i + 2], destination[i + 1], destination[i]);
+        }
+    });
+
+    return resultImage;
+};
+
+// Leaves every color unchanged.
+TGAColorMatrix TGAColorMatrix::identity() {
+    return scale(1.0f, 1.0f, 1.0f);
+};
+
+// Takes each output channel from an input channel.
+TGAColorMatrix TGAColorMatrix::swizzle(int redSource, int greenSource, int blueSource) {
+    if (redSource < 0 || redSource > 2 || greenSource < 0 || greenSource > 2 || blueSource < 0 || blueSource > 2) {
+        cout << "Error: Swizzle sources must be 0 (red), 1 (green) or 2 (blue)." << endl;
+        return identity();
+    }
+
+    TGAColorMatrix matrix = {};
+    matrix.m[0][redSource] = 1.0f;
+    matrix.m[1][greenSource] = 1.0f;
+    matrix.m[2][blueSource] = 1.0f;
+    return matrix;
+};
+
+// Scales each channel and then adds an offset to it.
+TGAColorMatrix TGAColorMatrix::scale(float redScale, float greenScale, float blueScale,
+                                     float redOffset, float greenOffset, float blueOffset) {
+    TGAColorMatrix matrix = {{
+        { redScale, 0.0f, 0.0f, redOffset },
+        { 0.0f, greenScale, 0.0f, greenOffset },
+        { 0.0f, 0.0f, blueScale, blueOffset }
+    }};
+    return matrix;
+};
+
+// Replaces each color with its Rec. 601 luma.
+TGAColorMatrix TGAColorMatrix::desaturate() {
+    TGAColorMatrix matrix = {{
+        { 0.299f, 0.587f, 0.114f, 0.0f },
+        { 0.299f, 0.587f, 0.114f, 0.0f },
+        { 0.299f, 0.587f, 0.114f, 0.0f }
+    }};
+    return matrix;
+};
+
+// The classic sepia tone.
+TGAColorMatrix TGAColorMatrix::sepia() {
+    TGAColorMatrix matrix = {{
+        { 0.393f, 0.769f, 0.189f, 0.0f },
+        { 0.349f, 0.686f, 0.168f, 0.0f },
+        { 0.272f, 0.534f, 0.131f, 0.0f }
+    }};
+    return matrix;
+};
+
+// Applies a color matrix to every pixel.
+TGAImage TGAImage::colorMatrix(const TGAImage& image, const TGAColorMatrix& matrix) {
+    // Create a copy of the input image and transform it in place.
+    TGAImage resultImage = image;
+    colorMatrix(resultImage.view(), matrix, resultImage.view());
+    return resultImage;
+};
+
+// Applies a color matrix to every pixel of a view, picking the cheapest kernel that handles the matrix.
+bool TGAImage::colorMatrix(const TGAConstImageView& image, const TGAColorMatrix& matrix, const TGAImageView& result) {
+    if (image.width != result.width || image.height != result.height) {
+        cout << "Error: Dimension mismatch between the two views." << endl;
+        return false;
+    }
+
+    // Rows and columns are in red, green, blue order, pixels in blue, green, red order.
+    bool isSwizzle = true;
+    bool isDiagonal = true;
+    int sources[3];
+    for (int row = 0; row < 3; ++row) {
+        int ones = 0;
+        int zeros = 0;
+        for (int column = 0; column < 3; ++column) {
+            if (matrix.m[row][column] == 1.0f) {
+                ++ones;
+                sources[2 - row] = 2 - column;
+            } else if (matrix.m[row][column] == 0.0f) {
+                ++zeros;
+            }
+            if (row != column && matrix.m[row][column] != 0.0f) {
+                isDiagonal = false;
+            }
+        }
+        if (ones != 1 || zeros != 2 || matrix.m[row][3] != 0.0f) {
+            isSwizzle = false;
+        }
+    }
+
+    int width = image.width;
+    const unsigned char* source = image.data;
+    int sourceStride = image.stride;
+    unsigned char* destination = result.data;
+    int destinationStride = result.stride;
+
+    if (isSwizzle) {
+        // Each output byte is a copy of one input byte, read before writing so it works in place.
+        int blueSource = sources[0], greenSource = sources[1], redSource = sources[2];
+        parallelRows(image.height, [=](int firstRow, int endRow) {
+            for (int y = firstRow; y < endRow; ++y) {
+                const unsigned char* in = source + y * sourceStride;
+                unsigned char* out = destination + y * destinationStride;
+                for (int x = 0; x < width * 3; x += 3) {
+                    unsigned char blue = in[x + blueSource];
+                    unsigned char green = in[x + greenSource];
+                    unsigned char red = in[x + redSource];
+                    out[x] = blue;
+                    out[x + 1] = green;
+                    out[x + 2] = red;
+                }
+            }
+        });
+        return true;
+    }
+
+    if (isDiagonal) {
+        // Each channel only depends on itself, so every possible value can be looked up.
+        struct Tables {
+            unsigned char channel[3][256];
+        };
+        Tables tables;
+        // Only 256 entries per channel, so they're worked out in floating point and rounded exactly once.
+        for (int channel = 0; channel < 3; ++channel) {
+            float weight = max(-256.0f, min(256.0f, matrix.m[2 - channel][2 - channel]));
+            float offset = max(-1024.0f, min(1024.0f, matrix.m[2 - channel][3]));
+            for (int value = 0; value < 256; ++value) {
+                float level = floor(value * weight + offset + 0.5f);
+                tables.channel[channel][value] = static_cast<unsigned char>(max(0.0f, min(255.0f, level)));
+            }
+        }
+
+        parallelRows(image.height, [=](int firstRow, int endRow) {
+            for (int y = firstRow; y < endRow; ++y) {
+                const unsigned char* in = source + y * sourceStride;
+                unsigned char* out = destination + y * destinationStride;
+                for (int x = 0; x < width * 3; x += 3) {
+                    out[x] = tables.channel[0][in[x]];
+                    out[x + 1] = tables.channel[1][in[x + 1]];
+                    out[x + 2] = tables.channel[2][in[x + 2]];
+                }
+            }
+        });
+        return true;
+    }
+
+    // General case: a fixed-point weighted sum for every output channel.
+    struct Weights {
+        int row[3][4];
+    };
+    Weights weights;
+    for (int row = 0; row < 3; ++row) {
+        for (int column = 0; column < 3; ++column) {
+            weights.row[row][column] = matrixFixed(matrix.m[row][column], 256.0f);
+        }
+        weights.row[row][3] = matrixFixed(matrix.m[row][3], 1024.0f);
+    }
+
+    parallelRows(image.height, [=](int firstRow, int endRow) {
+        for (int y = firstRow; y < endRow; ++y) {
+            const unsigned char* in = source + y * sourceStride;
+            unsigned char* out = destination + y * destinationStride;
+            for (int x = 0; x < width * 3; x += 3) {
+                int blue = in[x], green = in[x + 1], red = in[x + 2];
+                out[x] = matrixRow(weights.row[2], red, green, blue);
+                out[x + 1] = matrixRow(weights.row[1], red, green, blue);
+                out[x + 2] = matrixRow(weights.row[0], red, green, blue);
+            }
+        }
+    });
+    return true;
+};
@@ -0,0 +1,216 @@
+#include "TGAImage.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+using namespace std;
+
+// Morphology for TGAImage. A rectangle filter is separable, so each operation is a horizontal pass over
+// rows followed by a vertical pass over columns, both using the van Herk/Gil-Werman algorithm: three
+// comparisons per value whatever the radius.
+namespace {
+
+// C = min(A, B), with 255 (which never wins) for pixels outside the image.
+struct ErodeOp {
+    static const unsigned char identity = 255;
+    static inline unsigned char apply(unsigned char a, unsigned char b) {
+        return a < b ? a : b;
+    }
+};
+
+// C = max(A, B), with 0 for pixels outside the image.
+struct DilateOp {
+    static const unsigned char identity = 0;
+    static inline unsigned char apply(unsigned char a, unsigned char b) {
+        return a > b ? a : b;
+    }
+};
+
+// Width in bytes of the column bands the vertical pass works on. Each band is filtered a whole row
+// segment at a time, so the inner loops run over contiguous bytes.
+const int COLUMN_BAND_BYTES = 512;
+
+// Filters a line of count elements of elementBytes bytes, element i being at source + i * sourceStep,
+// with a window of 2 * radius + 1 elements. forward and backward need room for count + 2 * radius elements,
+// and padding is one element of Op::identity. Reads the whole line before writing, so it works in place.
+template <typename Op>
+void filterLine(const unsigned char* source, size_t sourceStep, unsigned char* destination, size_t destinationStep,
+                int count, int elementBytes, int radius, unsigned char* forward, unsigned char* backward,
+                const unsigned char* padding) {
+    int window = 2 * radius + 1;
+    int padded = count + 2 * radius;
+
+    // Element j of the line with radius elements of padding at each end.
+    auto element = [&](int j) {
+        return (j < radius || j >= count + radius) ? padding : source + (j - radius) * sourceStep;
+    };
+
+    // Running result from the start of each block of window elements.
+    for (int j = 0; j < padded; ++j) {
+        const unsigned char* in = element(j);
+        unsigned char* out = forward + static_cast<size_t>(j) * elementBytes;
+        if (j % window == 0) {
+            memcpy(out, in, elementBytes);
+        } else {
+            const unsigned char* previous = out - elementBytes;
+            for (int b = 0; b < elementBytes; ++b) {
+                out[b] = Op::apply(previous[b], in[b]);
+            }
+        }
+    }
+
+    // Running result from the end of each block.
+    for (int j = padded - 1; j >= 0; --j) {
+        const unsigned char* in = element(j);
+        unsigned char* out = backward + static_cast<size_t>(j) * elementBytes;
+        if (j == padded - 1 || (j + 1) % window == 0) {
+            memcpy(out, in, elementBytes);
+        } else {
+            const unsigned char* next = out + elementBytes;
+            for (int b = 0; b < elementBytes; ++b) {
+                out[b] = Op::apply(next[b], in[b]);
+            }
+        }
+    }
+
+    // Every window [i, i + 2 * radius] of the padded line is the end of one block plus the start of the next.
+    for (int i = 0; i < count; ++i) {
+        const unsigned char* end = backward + static_cast<size_t>(i) * elementBytes;
+        const unsigned char* start = forward + static_cast<size_t>(i + 2 * radius) * elementBytes;
+        unsigned char* out = destination + i * destinationStep;
+        for (int b = 0; b < elementBytes; ++b) {
+            out[b] = Op::apply(end[b], start[b]);
+        }
+    }
+};
+
+// Applies a rectangle filter to width x height pixels of channels bytes each. The destination may be the source.
+template <typename Op>
+void morphology(const unsigned char* source, unsigned char* destination, int width, int height, int channels,
+                int radiusX, int radiusY) {
+    // A window reaching past both ends of the image covers all of it, so larger radii change nothing.
+    radiusX = max(0, min(radiusX, width));
+    radiusY = max(0, min(radiusY, height));
+    int rowBytes = width * channels;
+
+    // Horizontal pass, a row at a time, with a pixel as the element.
+    parallelRows(height, [=](int firstRow, int endRow) {
+        vector<unsigned char> forward((width + 2 * radiusX) * channels);
+        vector<unsigned char> backward(forward.size());
+        vector<unsigned char> padding(channels, Op::identity);
+        for (int y = firstRow; y < endRow; ++y) {
+            const unsigned char* in = source + static_cast<size_t>(y) * rowBytes;
+            unsigned char* out = destination + static_cast<size_t>(y) * rowBytes;
+            if (radiusX == 0) {
+                memmove(out, in, rowBytes);
+            } else {
+                filterLine<Op>(in, channels, out, channels, width, channels, radiusX, forward.data(), backward.data(),
+                               padding.data());
+            }
+        }
+    });
+
+    if (radiusY == 0) {
+        return;
+    }
+
+    // Vertical pass in place, over bands of columns, with a row of the band as the element.
+    int bandCount = (rowBytes + COLUMN_BAND_BYTES - 1) / COLUMN_BAND_BYTES;
+    parallelRows(bandCount, [=](int firstBand, int endBand) {
+        vector<unsigned char> forward(static_cast<size_t>(height + 2 * radiusY) * COLUMN_BAND_BYTES);
+        vector<unsigned char> backward(forward.size());
+        vector<unsigned char> padding(COLUMN_BAND_BYTES, Op::identity);
+        for (int band = firstBand; band < endBand; ++band) {
+            int firstByte = band * COLUMN_BAND_BYTES;
+            int bandBytes = min(COLUMN_BAND_BYTES, rowBytes - firstByte);
+            filterLine<Op>(destination + firstByte, rowBytes, destination + firstByte, rowBytes, height, bandBytes,
+                           radiusY, forward.data(), backward.data(), padding.data());
+        }
+    }, 1);
+};
+
+// Checks a mask is width x height and sizes the result to match.
+bool prepareMask(const vector<unsigned char>& mask, int width, int height, vector<unsigned char>& result) {
+    if (width < 0 || height < 0 || mask.size() != static_cast<size_t>(width) * height) {
+        cout << "Error: Mask size doesn't match its dimensions." << endl;
+        return false;
+    }
+    result.resize(mask.size());
+    return true;
+};
+
+}
+
+// Takes the minimum of each rectangle.
+TGAImage TGAImage::erodeImage(const TGAImage& image, int radiusX, int radiusY) {
+    TGAImage resultImage = image;
+    morphology<ErodeOp>(image.imageData.data(), resultImage.imageData.data(), image.getWidth(), image.getHeight(), 3,
+                        radiusX, radiusY);
+    return resultImage;
+};
+
+// Takes the maximum of each rectangle.
+TGAImage TGAImage::dilateImage(const TGAImage& image, int radiusX, int radiusY) {
+    TGAImage resultImage = image;
+    morphology<DilateOp>(image.imageData.data(), resultImage.imageData.data(), image.getWidth(), image.getHeight(), 3,
+                         radiusX, radiusY);
+    return resultImage;
+};
+
+// Erodes and then dilates.
+TGAImage TGAImage::openImage(const TGAImage& image, int radiusX, int radiusY) {
+    TGAImage resultImage = erodeImage(image, radiusX, radiusY);
+    unsigned char* pixels = resultImage.imageData.data();
+    morphology<DilateOp>(pixels, pixels, image.getWidth(), image.getHeight(), 3, radiusX, radiusY);
+    return resultImage;
+};
+
+// Dilates and then erodes.
+TGAImage TGAImage::closeImage(const TGAImage& image, int radiusX, int radiusY) {
+    TGAImage resultImage = dilateImage(image, radiusX, radiusY);
+    unsigned char* pixels = resultImage.imageData.data();
+    morphology<ErodeOp>(pixels, pixels, image.getWidth(), image.getHeight(), 3, radiusX, radiusY);
+    return resultImage;
+};
+
+// Erodes an 8-bit mask. The result may be the mask itself.
+bool TGAImage::erodeMask(const vector<unsigned char>& mask, int width, int height, int radiusX, int radiusY,
+                         vector<unsigned char>& result) {
+    if (!prepareMask(mask, width, height, result)) {
+        return false;
+    }
+    morphology<ErodeOp>(mask.data(), result.data(), width, height, 1, radiusX, radiusY);
+    return true;
+};
+
+// Dilates an 8-bit mask.
+bool TGAImage::dilateMask(const vector<unsigned char>& mask, int width, int height, int radiusX, int radiusY,
+                          vector<unsigned char>& result) {
+    if (!prepareMask(mask, width, height, result)) {
+        return false;
+    }
+    morphology<DilateOp>(mask.data(), result.data(), width, height, 1, radiusX, radiusY);
+    return true;
+};
+
+// Opens an 8-bit mask.
+bool TGAImage::openMask(const vector<unsigned char>& mask, int width, int height, int radiusX, int radiusY,
+                        vector<unsigned char>& result) {
+    if (!prepareMask(mask, width, height, result)) {
+        return false;
+    }
+    morphology<ErodeOp>(mask.data(), result.data(), width, height, 1, radiusX, radiusY);
+    morphology<DilateOp>(result.data(), result.data(), width, height, 1, radiusX, radiusY);
+    return true;
+};
+
+// Closes an 8-bit mask.
+bool TGAImage::closeMask(const vector<unsigned char>& mask, int width, int height, int radiusX, int radiusY,
+                         vector<unsigned char>& result) {
+    if (!prepareMask(mask, width, height, result)) {
+        return false;
+    }
+    morphology<DilateOp>(mask.data(), result.data(), width, height, 1, radiusX, radiusY);
+    morphology<ErodeOp>(result.data(), result.data(), width, height, 1, radiusX, radiusY);
+    return true;
+};
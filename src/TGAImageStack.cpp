@@ -0,0 +1,301 @@
+#include "TGAImage.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+using namespace std;
+
+// N-way reductions for TGAImage. Layers are the same size and stored contiguously, so a reduction is a loop
+// over value positions; it is split into tiles small enough that the result tile (and the median's scratch
+// rows) stay in cache while each layer's tile streams past, and bands of tiles run on separate threads.
+namespace {
+
+// C = min(A, B)
+struct StackMinOp {
+    static inline unsigned char apply(unsigned char a, unsigned char b) {
+        return a < b ? a : b;
+    }
+};
+
+// C = max(A, B)
+struct StackMaxOp {
+    static inline unsigned char apply(unsigned char a, unsigned char b) {
+        return a > b ? a : b;
+    }
+};
+
+// C = min(A + B, 255). Saturating at every step gives the same result as saturating the full sum,
+// because nothing is ever subtracted.
+struct StackSumOp {
+    static inline unsigned char apply(unsigned char a, unsigned char b) {
+        unsigned int value = a + b;
+        return static_cast<unsigned char>(value > 255 ? 255 : value);
+    }
+};
+
+// Largest divisor weightedLayers takes. The sums it divides are at most 255 * divisor plus divisor / 2
+// for rounding, which must fit in 32 bits, and 256 * (2^24 - 1) does.
+const unsigned int MAX_DIVISOR = (1u << 24) - 1;
+
+// Checks there is at least one layer and they are all the same size.
+bool checkLayers(const vector<const TGAImage*>& layers) {
+    if (layers.empty()) {
+        cout << "Error: No layers to combine." << endl;
+        return false;
+    }
+    for (size_t i = 1; i < layers.size(); ++i) {
+        if (layers[i]->getWidth() != layers[0]->getWidth() || layers[i]->getHeight() != layers[0]->getHeight()) {
+            cout << "Error: Dimension mismatch between the layers." << endl;
+            return false;
+        }
+    }
+    return true;
+};
+
+// Values per tile: smaller tiles for more layers, so the median's layers x tile scratch stays around 64 KB.
+size_t tileValuesFor(size_t layerCount) {
+    size_t values = 65536 / layerCount;
+    return max<size_t>(256, min<size_t>(4096, values)) & ~static_cast<size_t>(63);
+};
+
+// Builds Batcher's odd-even merge sorting network for count values as (low, high) index pairs, keeping only
+// the comparisons the value at index keep depends on. The network is built for the next power of two;
+// comparisons touching the padding are dropped, which is the same as padding with values that sort last.
+vector<pair<int, int> > medianNetwork(int count, int keep) {
+    int size = 1;
+    while (size < count) {
+        size <<= 1;
+    }
+
+    vector<pair<int, int> > network;
+    for (int p = 1; p < size; p <<= 1) {
+        for (int k = p; k >= 1; k >>= 1) {
+            for (int j = k % p; j + k < size; j += 2 * k) {
+                for (int i = 0; i < min(k, size - j - k); ++i) {
+                    int low = i + j;
+                    int high = i + j + k;
+                    if (low / (2 * p) == high / (2 * p) && high < count) {
+                        network.push_back(make_pair(low, high));
+                    }
+                }
+            }
+        }
+    }
+
+    // Walks backwards from the kept index, dropping comparisons whose outputs nothing needed reads.
+    vector<bool> needed(count, false);
+    needed[keep] = true;
+    vector<pair<int, int> > pruned;
+    for (size_t i = network.size(); i-- > 0;) {
+        if (needed[network[i].first] || needed[network[i].second]) {
+            needed[network[i].first] = true;
+            needed[network[i].second] = true;
+            pruned.push_back(network[i]);
+        }
+    }
+    reverse(pruned.begin(), pruned.end());
+    return pruned;
+};
+
+// Gets the pixel data of every layer.
+vector<const unsigned char*> layerData(const vector<const TGAImage*>& layers) {
+    vector<const unsigned char*> data;
+    for (size_t i = 0; i < layers.size(); ++i) {
+        data.push_back(layers[i]->view().data);
+    }
+    return data;
+};
+
+// Folds every layer into the result tile with a per-value functor.
+template <typename FoldOp>
+TGAImage foldLayers(const vector<const TGAImage*>& layers) {
+    if (!checkLayers(layers)) {
+        return TGAImage();
+    }
+
+    TGAImage resultImage(layers[0]->getWidth(), layers[0]->getHeight());
+    vector<const unsigned char*> sources = layerData(layers);
+    unsigned char* destination = resultImage.view().data;
+    size_t valueCount = static_cast<size_t>(resultImage.getWidth()) * resultImage.getHeight() * 3;
+    size_t tileValues = tileValuesFor(layers.size());
+    int tileCount = static_cast<int>((valueCount + tileValues - 1) / tileValues);
+
+    parallelRows(tileCount, [=](int firstTile, int endTile) {
+        for (int tile = firstTile; tile < endTile; ++tile) {
+            size_t first = tile * tileValues;
+            size_t count = min(tileValues, valueCount - first);
+            unsigned char* out = destination + first;
+            memcpy(out, sources[0] + first, count);
+            for (size_t layer = 1; layer < sources.size(); ++layer) {
+                const unsigned char* in = sources[layer] + first;
+                for (size_t i = 0; i < count; ++i) {
+                    out[i] = FoldOp::apply(out[i], in[i]);
+                }
+            }
+        }
+    }, 8);
+
+    return resultImage;
+};
+
+// Sums every layer times its integer weight into a tile of accumulators, then divides by divisor and rounds.
+// With weights of 1 and a divisor of the layer count this is the mean. divisor is at most MAX_DIVISOR.
+TGAImage weightedLayers(const vector<const TGAImage*>& layers, const vector<unsigned int>& weights, unsigned int divisor) {
+    TGAImage resultImage(layers[0]->getWidth(), layers[0]->getHeight());
+    vector<const unsigned char*> sources = layerData(layers);
+    unsigned char* destination = resultImage.view().data;
+    size_t valueCount = static_cast<size_t>(resultImage.getWidth()) * resultImage.getHeight() * 3;
+    size_t tileValues = tileValuesFor(layers.size());
+    int tileCount = static_cast<int>((valueCount + tileValues - 1) / tileValues);
+
+    // Divides with a multiply and shift. floor(2^32 / divisor) gives the quotient or one less for any 32-bit
+    // numerator, and a compare against the remainder fixes the second case, so the division is exact.
+    unsigned long long reciprocal = (1ULL << 32) / divisor;
+
+    parallelRows(tileCount, [=](int firstTile, int endTile) {
+        vector<unsigned int> sums(tileValues);
+        unsigned int* sum = sums.data();
+        for (int tile = firstTile; tile < endTile; ++tile) {
+            size_t first = tile * tileValues;
+            size_t count = min(tileValues, valueCount - first);
+            memset(sum, 0, count * sizeof(unsigned int));
+            for (size_t layer = 0; layer < sources.size(); ++layer) {
+                const unsigned char* in = sources[layer] + first;
+                unsigned int weight = weights[layer];
+                for (size_t i = 0; i < count; ++i) {
+                    sum[i] += in[i] * weight;
+                }
+            }
+
+            unsigned char* out = destination + first;
+            for (size_t i = 0; i < count; ++i) {
+                unsigned int numerator = sum[i] + divisor / 2;
+                unsigned int value = static_cast<unsigned int>((numerator * reciprocal) >> 32);
+                value += numerator - value * divisor >= divisor ? 1 : 0;
+                out[i] = static_cast<unsigned char>(value > 255 ? 255 : value);
+            }
+        }
+    }, 8);
+
+    return resultImage;
+};
+
+}
+
+// Rounded mean of the layers.
+TGAImage TGAImage::meanImages(const vector<const TGAImage*>& layers) {
+    if (!checkLayers(layers)) {
+        return TGAImage();
+    }
+    if (layers.size() > MAX_DIVISOR) {
+        cout << "Error: Too many layers to average." << endl;
+        return TGAImage();
+    }
+    return weightedLayers(layers, vector<unsigned int>(layers.size(), 1), static_cast<unsigned int>(layers.size()));
+};
+
+// Median of the layers, using a sorting network on whole tiles at a time.
+TGAImage TGAImage::medianImages(const vector<const TGAImage*>& layers) {
+    TGAImage resultImage;
+    medianImages(layers, resultImage);
+    return resultImage;
+};
+
+// Median of the layers into an existing image, reusing its buffer.
+bool TGAImage::medianImages(const vector<const TGAImage*>& layers, TGAImage& result) {
+    if (!checkLayers(layers)) {
+        result = TGAImage();
+        return false;
+    }
+
+    int layerCount = static_cast<int>(layers.size());
+    int middle = layerCount / 2;
+    vector<pair<int, int> > network = medianNetwork(layerCount, middle);
+
+    result.resize(layers[0]->getWidth(), layers[0]->getHeight());
+    vector<const unsigned char*> sources = layerData(layers);
+    unsigned char* destination = result.view().data;
+    size_t valueCount = static_cast<size_t>(result.getWidth()) * result.getHeight() * 3;
+    size_t tileValues = tileValuesFor(layers.size());
+    int tileCount = static_cast<int>((valueCount + tileValues - 1) / tileValues);
+
+    parallelRows(tileCount, [=](int firstTile, int endTile) {
+        // One scratch row per layer. Every comparison is a min/max of two whole rows, which vectorizes.
+        vector<unsigned char> scratch(layerCount * tileValues);
+        for (int tile = firstTile; tile < endTile; ++tile) {
+            size_t first = tile * tileValues;
+            size_t count = min(tileValues, valueCount - first);
+            for (int layer = 0; layer < layerCount; ++layer) {
+                memcpy(scratch.data() + layer * tileValues, sources[layer] + first, count);
+            }
+
+            for (size_t c = 0; c < network.size(); ++c) {
+                unsigned char* low = scratch.data() + network[c].first * tileValues;
+                unsigned char* high = scratch.data() + network[c].second * tileValues;
+                for (size_t i = 0; i < count; ++i) {
+                    unsigned char a = low[i];
+                    unsigned char b = high[i];
+                    low[i] = a < b ? a : b;
+                    high[i] = a < b ? b : a;
+                }
+            }
+
+            memcpy(destination + first, scratch.data() + middle * tileValues, count);
+        }
+    }, 8);
+
+    return true;
+};
+
+// Darkest value of the layers.
+TGAImage TGAImage::minImages(const vector<const TGAImage*>& layers) {
+    return foldLayers<StackMinOp>(layers);
+};
+
+// Lightest value of the layers.
+TGAImage TGAImage::maxImages(const vector<const TGAImage*>& layers) {
+    return foldLayers<StackMaxOp>(layers);
+};
+
+// Sum of the layers, saturating at 255.
+TGAImage TGAImage::sumImages(const vector<const TGAImage*>& layers) {
+    return foldLayers<StackSumOp>(layers);
+};
+
+// Average weighted by one non-negative weight per layer.
+TGAImage TGAImage::weightedAverageImages(const vector<const TGAImage*>& layers, const vector<float>& weights) {
+    if (!checkLayers(layers)) {
+        return TGAImage();
+    }
+    if (weights.size() != layers.size()) {
+        cout << "Error: There must be one weight per layer." << endl;
+        return TGAImage();
+    }
+
+    double total = 0.0;
+    for (size_t i = 0; i < weights.size(); ++i) {
+        if (!(weights[i] >= 0.0f)) {
+            cout << "Error: Layer weights can't be negative." << endl;
+            return TGAImage();
+        }
+        total += weights[i];
+    }
+    if (total <= 0.0) {
+        cout << "Error: Layer weights add up to 0." << endl;
+        return TGAImage();
+    }
+
+    // Normalizes the weights to fixed point adding up to about 2^23, and divides by what the rounded weights
+    // really add up to, so equal weights give exactly the mean however many layers there are.
+    vector<unsigned int> fixedWeights(weights.size());
+    unsigned long long fixedTotal = 0;
+    for (size_t i = 0; i < weights.size(); ++i) {
+        fixedWeights[i] = static_cast<unsigned int>(weights[i] / total * 8388608.0 + 0.5);
+        fixedTotal += fixedWeights[i];
+    }
+    if (fixedTotal == 0 || fixedTotal > MAX_DIVISOR) {
+        cout << "Error: Too many layers to average." << endl;
+        return TGAImage();
+    }
+    return weightedLayers(layers, fixedWeights, static_cast<unsigned int>(fixedTotal));
+};
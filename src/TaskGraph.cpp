@@ -0,0 +1,263 @@
+#include "TaskGraph.h"
+#include "Parallel.h"
+#include <iostream>
+#include <thread>
+using namespace std;
+
+namespace {
+
+// Bytes acquired so far by the stage running on this thread, nullptr outside a stage.
+thread_local size_t* stageAcquiredBytes = nullptr;
+
+}
+
+TaskGraph::TaskGraph() : liveBytes(0), peakBytes(0), queuedStages(0), unfinishedStages(0), anyFailed(false) {
+};
+
+// Adds a stage that runs after all of its input stages have finished.
+int TaskGraph::addStage(const string& name, const vector<int>& inputs, StageFunction function) {
+    int id = static_cast<int>(stages.size());
+
+    Stage stage;
+    stage.name = name;
+    stage.function = function;
+    stage.pendingInputs = 0;
+    stage.pendingConsumers = 0;
+    stage.acquiredBytes = 0;
+    stage.kept = false;
+    stage.failed = false;
+    stages.push_back(stage);
+
+    // Inputs must already be in the graph, which also keeps the graph free of cycles.
+    // A stage with a missing input is left to fail when it runs.
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        if (inputs[i] < 0 || inputs[i] >= id) {
+            cout << "Error: Stage " << name << " depends on a stage that doesn't exist yet." << endl;
+            stages.back().failed = true;
+            continue;
+        }
+        stages.back().inputs.push_back(inputs[i]);
+        stages[inputs[i]].dependents.push_back(id);
+    }
+
+    return id;
+};
+
+// Runs every stage of the graph on a pool of work-stealing threads.
+bool TaskGraph::run(int threadCount) {
+    if (threadCount <= 0) {
+        threadCount = max(1, static_cast<int>(thread::hardware_concurrency()));
+    }
+
+    // Resets the scheduling state and gives every worker its own queue.
+    queuedStages = 0;
+    unfinishedStages = static_cast<int>(stages.size());
+    anyFailed = false;
+    liveBytes = 0;
+    peakBytes = 0;
+    for (int worker = 0; worker < threadCount; ++worker) {
+        queues.push_back(new WorkerQueue());
+    }
+
+    // Stages without inputs are ready straight away, deal them out round-robin. Only inputs that exist
+    // were recorded by addStage, so a stage with a missing input still becomes ready and fails when it
+    // runs instead of waiting forever for a stage that will never finish.
+    int nextWorker = 0;
+    for (size_t stage = 0; stage < stages.size(); ++stage) {
+        stages[stage].pendingInputs = static_cast<int>(stages[stage].inputs.size());
+        stages[stage].pendingConsumers = static_cast<int>(stages[stage].dependents.size());
+        stages[stage].acquiredBytes = 0;
+        if (stages[stage].pendingInputs == 0) {
+            pushStage(nextWorker, static_cast<int>(stage));
+            nextWorker = (nextWorker + 1) % threadCount;
+        }
+    }
+
+    // The calling thread works as worker 0.
+    vector<thread> workers;
+    for (int worker = 1; worker < threadCount; ++worker) {
+        workers.push_back(thread(&TaskGraph::workerLoop, this, worker));
+    }
+    workerLoop(0);
+
+    for (size_t i = 0; i < workers.size(); ++i) {
+        workers[i].join();
+    }
+    for (size_t i = 0; i < queues.size(); ++i) {
+        delete queues[i];
+    }
+    queues.clear();
+
+    // Nothing is left to reuse the freed buffers.
+    pool.clear();
+
+    return !anyFailed;
+};
+
+// Keeps a stage's output after the graph has run.
+void TaskGraph::keepOutput(int stage) {
+    stages[stage].kept = true;
+};
+
+// Gets the output image of a kept stage after the graph has run.
+const TGAImage& TaskGraph::getOutput(int stage) const {
+    return stages[stage].output;
+};
+
+// Gets an image for a stage's output, reusing a freed buffer if there is one. The buffer counts as alive
+// from here on, so a stage holding several of them shows up in the peak while it runs.
+TGAImage TaskGraph::acquireImage(int width, int height) {
+    lock_guard<mutex> guard(stateLock);
+    TGAImage image = pool.acquire(width, height);
+    size_t bytes = image.getCapacity();
+    liveBytes += bytes;
+    peakBytes = max(peakBytes, liveBytes + pool.getPooledBytes());
+    if (stageAcquiredBytes != nullptr) {
+        *stageAcquiredBytes += bytes;
+    }
+    return image;
+};
+
+// Gets the most bytes held by stage outputs, acquired images and pooled buffers at once during the last run.
+size_t TaskGraph::getPeakBytes() const {
+    return peakBytes;
+};
+
+// Main loop of each worker thread: run ready stages until every stage has finished.
+void TaskGraph::workerLoop(int worker) {
+    while (true) {
+        int stage;
+        if (takeStage(worker, stage)) {
+            runStage(stage);
+            finishStage(worker, stage);
+            continue;
+        }
+
+        // Nothing to take, sleep until a stage is queued or the graph is done.
+        unique_lock<mutex> guard(stateLock);
+        stateChanged.wait(guard, [this]() { return queuedStages > 0 || unfinishedStages == 0; });
+        if (unfinishedStages == 0) {
+            return;
+        }
+    }
+};
+
+// Takes the newest stage from the worker's own queue, or the oldest stage from another worker's queue.
+bool TaskGraph::takeStage(int worker, int& stage) {
+    int workerCount = static_cast<int>(queues.size());
+    for (int offset = 0; offset < workerCount; ++offset) {
+        WorkerQueue& queue = *queues[(worker + offset) % workerCount];
+        lock_guard<mutex> guard(queue.lock);
+        if (queue.stages.empty()) {
+            continue;
+        }
+
+        // The owner works depth-first on what it just unlocked, thieves take the oldest work.
+        if (offset == 0) {
+            stage = queue.stages.back();
+            queue.stages.pop_back();
+        } else {
+            stage = queue.stages.front();
+            queue.stages.pop_front();
+        }
+
+        lock_guard<mutex> stateGuard(stateLock);
+        --queuedStages;
+        return true;
+    }
+    return false;
+};
+
+// Runs a stage, or skips it if one of its inputs failed.
+void TaskGraph::runStage(int stage) {
+    Stage& current = stages[stage];
+
+    vector<const TGAImage*> inputs;
+    for (size_t i = 0; i < current.inputs.size() && !current.failed; ++i) {
+        if (stages[current.inputs[i]].failed) {
+            cout << "Skipping " << current.name << " because " << stages[current.inputs[i]].name << " failed." << endl;
+            current.failed = true;
+        }
+        inputs.push_back(&stages[current.inputs[i]].output);
+    }
+    if (current.failed) {
+        return;
+    }
+
+    // Row-level parallelism inside the stage shares the machine with the other running stages.
+    ++concurrentStageCount();
+    stageAcquiredBytes = &current.acquiredBytes;
+    bool success = current.function(inputs, current.output);
+    stageAcquiredBytes = nullptr;
+    --concurrentStageCount();
+
+    if (!success) {
+        cout << "Error: Stage " << current.name << " failed." << endl;
+        current.failed = true;
+    }
+};
+
+// Marks a stage as finished and queues the dependents it was the last input of.
+void TaskGraph::finishStage(int worker, int stage) {
+    vector<int> ready;
+    {
+        lock_guard<mutex> guard(stateLock);
+        if (stages[stage].failed) {
+            anyFailed = true;
+        }
+        for (size_t i = 0; i < stages[stage].dependents.size(); ++i) {
+            int dependent = stages[stage].dependents[i];
+            if (--stages[dependent].pendingInputs == 0) {
+                ready.push_back(dependent);
+            }
+        }
+
+        // What the stage acquired is either its output now or was dropped with its temporaries, so only the
+        // output stays alive. Measure before anything is freed.
+        liveBytes -= stages[stage].acquiredBytes;
+        liveBytes += stages[stage].output.getCapacity();
+        peakBytes = max(peakBytes, liveBytes + pool.getPooledBytes());
+
+        // Inputs this stage was the last consumer of, and an output nothing reads, are dead.
+        for (size_t i = 0; i < stages[stage].inputs.size(); ++i) {
+            int input = stages[stage].inputs[i];
+            if (--stages[input].pendingConsumers == 0) {
+                releaseOutput(input);
+            }
+        }
+        if (stages[stage].dependents.empty()) {
+            releaseOutput(stage);
+        }
+    }
+
+    for (size_t i = 0; i < ready.size(); ++i) {
+        pushStage(worker, ready[i]);
+    }
+
+    // Wakes everyone up when the last stage finishes so the workers can exit.
+    lock_guard<mutex> guard(stateLock);
+    if (--unfinishedStages == 0) {
+        stateChanged.notify_all();
+    }
+};
+
+// Puts a ready stage on a worker's queue and wakes an idle worker.
+void TaskGraph::pushStage(int worker, int stage) {
+    {
+        lock_guard<mutex> guard(queues[worker]->lock);
+        queues[worker]->stages.push_back(stage);
+    }
+
+    lock_guard<mutex> guard(stateLock);
+    ++queuedStages;
+    stateChanged.notify_one();
+};
+
+// Gives a stage's output buffer to the pool unless it is kept.
+void TaskGraph::releaseOutput(int stage) {
+    if (stages[stage].kept) {
+        return;
+    }
+    liveBytes -= stages[stage].output.getCapacity();
+    pool.release(stages[stage].output);
+};
@@ -0,0 +1,113 @@
+#ifndef TASK_GRAPH_H
+#define TASK_GRAPH_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ImagePool.h"
+#include "TGAImage.h"
+using namespace std;
+
+
+// Defining a class that runs the stages of an image pipeline as a dependency graph.
+// Each stage declares the stages whose output images it reads, and stages whose inputs are
+// all finished run concurrently on a pool of work-stealing threads.
+//
+// The graph also plans buffer lifetimes: each output is freed as soon as the last stage reading it
+// has finished, and its buffer goes to a pool that later stages draw from with acquireImage. Peak memory
+// then follows the widest point of the pipeline rather than the sum of every image in it.
+class TaskGraph {
+public:
+    // Function run by a stage. It gets the outputs of its input stages, in the order they were
+    // declared, and fills in its own output image. Returns false if the stage failed.
+    typedef function<bool(const vector<const TGAImage*>& inputs, TGAImage& output)> StageFunction;
+
+    TaskGraph();
+
+    // Adds a stage that runs after all of its input stages have finished. Returns the stage's id.
+    int addStage(const string& name, const vector<int>& inputs, StageFunction function);
+
+    // Runs every stage, using one thread per core when threadCount is 0.
+    // Returns false if any stage failed, stages depending on a failed stage are skipped.
+    //
+    // Row-level parallelism inside a stage doesn't go through these workers: each parallelRows call
+    // starts its own threads. It divides the cores by the number of stages running at the time, so the
+    // machine isn't oversubscribed N times over, but a stage can't use cores that free up while it runs
+    // and idle workers can't steal its rows.
+    bool run(int threadCount = 0);
+
+    // Keeps a stage's output after the graph has run, instead of freeing it once its consumers are done.
+    void keepOutput(int stage);
+
+    // Gets the output image of a kept stage after the graph has run. Other outputs are empty by then.
+    const TGAImage& getOutput(int stage) const;
+
+    // Gets an image for a stage to write its output into, reusing the buffer of a freed output when
+    // one is big enough. The pixel contents are left unspecified. Safe to call from stage functions,
+    // on the thread that runs the stage.
+    TGAImage acquireImage(int width, int height);
+
+    // Gets the most bytes held by stage outputs, acquired images and pooled buffers at once during the last run.
+    // It is sampled whenever a stage acquires an image and when a stage finishes.
+    size_t getPeakBytes() const;
+
+private:
+    // Defining a structure to hold a stage and its place in the graph.
+    struct Stage {
+        string name;
+        vector<int> inputs;
+        vector<int> dependents;
+        StageFunction function;
+        TGAImage output;
+        int pendingInputs;
+        int pendingConsumers;
+        size_t acquiredBytes;
+        bool kept;
+        bool failed;
+    };
+
+    // Defining a structure to hold the queue of ready stages owned by one worker.
+    struct WorkerQueue {
+        mutex lock;
+        deque<int> stages;
+    };
+
+    vector<Stage> stages;
+
+    // Buffers of freed outputs, and the bytes held by outputs that are still alive or being written.
+    ImagePool pool;
+    size_t liveBytes;
+    size_t peakBytes;
+
+    // Scheduling state, only used while run() is in progress.
+    vector<WorkerQueue*> queues;
+    mutex stateLock;
+    condition_variable stateChanged;
+    int queuedStages;
+    int unfinishedStages;
+    bool anyFailed;
+
+    // Main loop of each worker thread.
+    void workerLoop(int worker);
+
+    // Takes a ready stage from the worker's own queue, or steals one from another worker.
+    bool takeStage(int worker, int& stage);
+
+    // Runs a stage, or skips it if one of its inputs failed.
+    void runStage(int stage);
+
+    // Marks a stage as finished, frees the outputs it was the last consumer of and queues the
+    // dependents it was the last input of.
+    void finishStage(int worker, int stage);
+
+    // Gives a stage's output buffer to the pool unless it is kept. Called with stateLock held.
+    void releaseOutput(int stage);
+
+    // Puts a ready stage on a worker's queue and wakes an idle worker.
+    void pushStage(int worker, int stage);
+};
+
+#endif // TASK_GRAPH_H
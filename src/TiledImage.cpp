@@ -0,0 +1,452 @@
+#include "TiledImage.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+using namespace std;
+
+namespace {
+
+const char TILED_MAGIC[4] = { 'T', 'G', 'T', 'L' };
+const uint32_t TILED_VERSION = 1;
+const int HEADER_SIZE = 32;
+const int INDEX_ENTRY_SIZE = 16;
+
+// Keeps a tile's data under 4 GB (it's stored with a 32-bit size) and the index to at most 256 MB.
+const int MAX_TILE_SIZE = 8192;
+const long long MAX_TILES = 1 << 24;
+
+// Tile encodings.
+const unsigned char ENCODING_RAW = 1;
+const unsigned char ENCODING_RLE = 2;
+
+// Writes a little-endian value of the given number of bytes.
+inline void writeLittleEndian(unsigned char* out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) {
+        out[i] = static_cast<unsigned char>(value >> (8 * i));
+    }
+};
+
+// Reads a little-endian value of the given number of bytes.
+inline uint64_t readLittleEndian(const unsigned char* in, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i) {
+        value |= static_cast<uint64_t>(in[i]) << (8 * i);
+    }
+    return value;
+};
+
+// Gets whether two BGR pixels are the same.
+inline bool samePixel(const unsigned char* a, const unsigned char* b) {
+    return a[0] == b[0] && a[1] == b[1] && a[2] == b[2];
+};
+
+// Encodes pixels as TGA-style RLE packets: a count byte with the top bit set followed by one pixel to
+// repeat, or a count byte without it followed by that many literal pixels. Counts are stored minus one.
+void encodeRLE(const unsigned char* pixels, size_t pixelCount, vector<unsigned char>& encoded) {
+    encoded.clear();
+    size_t i = 0;
+    while (i < pixelCount) {
+        size_t run = 1;
+        while (i + run < pixelCount && run < 128 && samePixel(pixels + (i + run) * 3, pixels + i * 3)) {
+            ++run;
+        }
+
+        if (run >= 2) {
+            encoded.push_back(static_cast<unsigned char>(0x80 | (run - 1)));
+            encoded.insert(encoded.end(), pixels + i * 3, pixels + i * 3 + 3);
+            i += run;
+            continue;
+        }
+
+        // Literal pixels up to the start of the next run.
+        size_t start = i;
+        while (i < pixelCount && i - start < 128 && !(i + 1 < pixelCount && samePixel(pixels + i * 3, pixels + (i + 1) * 3))) {
+            ++i;
+        }
+        encoded.push_back(static_cast<unsigned char>(i - start - 1));
+        encoded.insert(encoded.end(), pixels + start * 3, pixels + i * 3);
+    }
+};
+
+// Decodes RLE packets into exactly pixelCount pixels. Returns false if the data is corrupt.
+bool decodeRLE(const vector<unsigned char>& encoded, unsigned char* pixels, size_t pixelCount) {
+    size_t in = 0;
+    size_t out = 0;
+    while (out < pixelCount) {
+        if (in >= encoded.size()) {
+            return false;
+        }
+        unsigned char packet = encoded[in++];
+        size_t count = (packet & 0x7f) + 1;
+        if (out + count > pixelCount) {
+            return false;
+        }
+
+        if (packet & 0x80) {
+            if (in + 3 > encoded.size()) {
+                return false;
+            }
+            for (size_t i = 0; i < count; ++i) {
+                memcpy(pixels + (out + i) * 3, encoded.data() + in, 3);
+            }
+            in += 3;
+        } else {
+            if (in + count * 3 > encoded.size()) {
+                return false;
+            }
+            memcpy(pixels + out * 3, encoded.data() + in, count * 3);
+            in += count * 3;
+        }
+        out += count;
+    }
+    return in == encoded.size();
+};
+
+}
+
+TiledImage::TiledImage()
+    : width(0), height(0), tileSize(0), compressed(false), tilesAcross(0), tilesDown(0), endOfData(0) {
+};
+
+// Creates a new tiled image file with an empty index.
+bool TiledImage::create(const string& filename, int width, int height, int tileSize, bool compressed) {
+    close();
+
+    if (width <= 0 || height <= 0 || tileSize <= 0 || tileSize > MAX_TILE_SIZE) {
+        cout << "Error: Invalid tiled image dimensions." << endl;
+        return false;
+    }
+    long long across = (static_cast<long long>(width) + tileSize - 1) / tileSize;
+    long long down = (static_cast<long long>(height) + tileSize - 1) / tileSize;
+    if (across * down > MAX_TILES) {
+        cout << "Error: Too many tiles, use a larger tile size." << endl;
+        return false;
+    }
+
+    file.open(filename, ios_base::in | ios_base::out | ios_base::binary | ios_base::trunc);
+    if (!file) {
+        cout << "Error: Failed to open the file for writing." << endl;
+        return false;
+    }
+
+    this->width = width;
+    this->height = height;
+    this->tileSize = tileSize;
+    this->compressed = compressed;
+    tilesAcross = static_cast<int>(across);
+    tilesDown = static_cast<int>(down);
+
+    // Writes the header followed by an index of unwritten tiles.
+    vector<unsigned char> start(HEADER_SIZE + across * down * INDEX_ENTRY_SIZE, 0);
+    memcpy(start.data(), TILED_MAGIC, 4);
+    writeLittleEndian(start.data() + 4, TILED_VERSION, 4);
+    writeLittleEndian(start.data() + 8, width, 4);
+    writeLittleEndian(start.data() + 12, height, 4);
+    writeLittleEndian(start.data() + 16, tileSize, 4);
+    writeLittleEndian(start.data() + 20, compressed ? 1 : 0, 4);
+    file.write(reinterpret_cast<const char*>(start.data()), start.size());
+    if (!file) {
+        cout << "Error: Failed to write the tiled image header." << endl;
+        close();
+        return false;
+    }
+
+    TileEntry empty = { 0, 0, 0 };
+    index.assign(across * down, empty);
+    endOfData = start.size();
+    return true;
+};
+
+// Opens an existing tiled image file and reads its index.
+bool TiledImage::open(const string& filename) {
+    close();
+
+    file.open(filename, ios_base::in | ios_base::out | ios_base::binary);
+    if (!file) {
+        cout << "Error: Failed to open the file for reading." << endl;
+        return false;
+    }
+
+    unsigned char header[HEADER_SIZE];
+    file.read(reinterpret_cast<char*>(header), HEADER_SIZE);
+    uint64_t headerWidth = readLittleEndian(header + 8, 4);
+    uint64_t headerHeight = readLittleEndian(header + 12, 4);
+    uint64_t headerTileSize = readLittleEndian(header + 16, 4);
+    if (!file || memcmp(header, TILED_MAGIC, 4) != 0 || readLittleEndian(header + 4, 4) != TILED_VERSION ||
+        headerWidth == 0 || headerWidth > 0x7fffffff || headerHeight == 0 || headerHeight > 0x7fffffff ||
+        headerTileSize == 0 || headerTileSize > MAX_TILE_SIZE) {
+        cout << "Error: Not a tiled image file." << endl;
+        close();
+        return false;
+    }
+
+    width = static_cast<int>(headerWidth);
+    height = static_cast<int>(headerHeight);
+    tileSize = static_cast<int>(headerTileSize);
+    compressed = (readLittleEndian(header + 20, 4) & 1) != 0;
+    long long across = (static_cast<long long>(width) + tileSize - 1) / tileSize;
+    long long down = (static_cast<long long>(height) + tileSize - 1) / tileSize;
+    if (across * down > MAX_TILES) {
+        cout << "Error: Not a tiled image file." << endl;
+        close();
+        return false;
+    }
+    tilesAcross = static_cast<int>(across);
+    tilesDown = static_cast<int>(down);
+
+    vector<unsigned char> entries(across * down * INDEX_ENTRY_SIZE);
+    file.read(reinterpret_cast<char*>(entries.data()), entries.size());
+    if (!file) {
+        cout << "Error: Tiled image index is truncated." << endl;
+        close();
+        return false;
+    }
+
+    // New tiles go after whatever tile data is furthest into the file.
+    index.resize(across * down);
+    endOfData = HEADER_SIZE + entries.size();
+    for (size_t i = 0; i < index.size(); ++i) {
+        const unsigned char* entry = entries.data() + i * INDEX_ENTRY_SIZE;
+        index[i].offset = readLittleEndian(entry, 8);
+        index[i].size = static_cast<uint32_t>(readLittleEndian(entry + 8, 4));
+        index[i].encoding = entry[12];
+        if (index[i].offset != 0) {
+            endOfData = max(endOfData, index[i].offset + index[i].size);
+        }
+    }
+    return true;
+};
+
+// Closes the file.
+void TiledImage::close() {
+    if (file.is_open()) {
+        file.close();
+    }
+    file.clear();
+    index.clear();
+    width = height = tileSize = tilesAcross = tilesDown = 0;
+    endOfData = 0;
+};
+
+bool TiledImage::isOpen() const {
+    return file.is_open();
+};
+
+int TiledImage::getWidth() const {
+    return width;
+};
+
+int TiledImage::getHeight() const {
+    return height;
+};
+
+int TiledImage::getTileSize() const {
+    return tileSize;
+};
+
+int TiledImage::getTilesAcross() const {
+    return tilesAcross;
+};
+
+int TiledImage::getTilesDown() const {
+    return tilesDown;
+};
+
+// Reads one tile, decoding it outside the file lock so several threads can read tiles at once.
+bool TiledImage::readTile(int tileX, int tileY, TGAImage& tile) {
+    TGARect rect;
+    if (!getTileRect(tileX, tileY, rect)) {
+        cout << "Error: Tile is outside of the image." << endl;
+        return false;
+    }
+
+    TileEntry entry;
+    vector<unsigned char> data;
+    {
+        lock_guard<mutex> lock(fileLock);
+        entry = index[tileY * tilesAcross + tileX];
+        if (entry.offset != 0) {
+            data.resize(entry.size);
+            file.seekg(static_cast<streamoff>(entry.offset));
+            file.read(reinterpret_cast<char*>(data.data()), data.size());
+            if (!file) {
+                file.clear();
+                cout << "Error: Failed to read tile data." << endl;
+                return false;
+            }
+        }
+    }
+
+    tile = TGAImage(rect.width, rect.height);
+    if (entry.offset == 0) {
+        // Never written, so it stays black.
+        return true;
+    }
+
+    size_t pixelCount = static_cast<size_t>(rect.width) * rect.height;
+    bool decoded = false;
+    if (entry.encoding == ENCODING_RAW && data.size() == pixelCount * 3) {
+        memcpy(tile.view().data, data.data(), data.size());
+        decoded = true;
+    } else if (entry.encoding == ENCODING_RLE) {
+        decoded = decodeRLE(data, tile.view().data, pixelCount);
+    }
+
+    if (!decoded) {
+        cout << "Error: Tile data is corrupt." << endl;
+        return false;
+    }
+    return true;
+};
+
+// Writes one tile, encoding it outside the file lock.
+bool TiledImage::writeTile(int tileX, int tileY, const TGAImage& tile) {
+    TGARect rect;
+    if (!getTileRect(tileX, tileY, rect)) {
+        cout << "Error: Tile is outside of the image." << endl;
+        return false;
+    }
+    if (tile.getWidth() != rect.width || tile.getHeight() != rect.height) {
+        cout << "Error: Dimension mismatch between the tile and the image." << endl;
+        return false;
+    }
+
+    // Uses RLE only when it actually saves space.
+    const unsigned char* pixels = tile.view().data;
+    size_t rawSize = static_cast<size_t>(rect.width) * rect.height * 3;
+    vector<unsigned char> encoded;
+    unsigned char encoding = ENCODING_RAW;
+    if (compressed) {
+        encodeRLE(pixels, rawSize / 3, encoded);
+        if (encoded.size() < rawSize) {
+            encoding = ENCODING_RLE;
+            pixels = encoded.data();
+        }
+    }
+    uint32_t size = static_cast<uint32_t>(encoding == ENCODING_RLE ? encoded.size() : rawSize);
+
+    lock_guard<mutex> lock(fileLock);
+    int tileNumber = tileY * tilesAcross + tileX;
+    TileEntry& entry = index[tileNumber];
+
+    // Reuses the tile's old space if the new data fits, otherwise appends it.
+    uint64_t offset = entry.offset != 0 && size <= entry.size ? entry.offset : endOfData;
+    file.seekp(static_cast<streamoff>(offset));
+    file.write(reinterpret_cast<const char*>(pixels), size);
+    if (!file) {
+        file.clear();
+        cout << "Error: Failed to write tile data." << endl;
+        return false;
+    }
+
+    if (offset == endOfData) {
+        endOfData += size;
+    }
+    entry.offset = offset;
+    entry.size = size;
+    entry.encoding = encoding;
+    return writeIndexEntry(tileNumber);
+};
+
+// Reads a rectangle of the image from the tiles that overlap it.
+bool TiledImage::readRegion(int x, int y, int width, int height, TGAImage& region) {
+    if (x < 0 || y < 0 || width <= 0 || height <= 0 || x > this->width - width || y > this->height - height) {
+        cout << "Error: Region is outside of the image." << endl;
+        return false;
+    }
+    if (!TGAImage::validDimensions(width, height)) {
+        cout << "Error: A " << width << "x" << height << " region is too big for one image." << endl;
+        return false;
+    }
+
+    region = TGAImage(width, height);
+    if (region.getWidth() == 0) {
+        return false;
+    }
+    TGAImage tile;
+    for (int tileY = y / tileSize; tileY <= (y + height - 1) / tileSize; ++tileY) {
+        for (int tileX = x / tileSize; tileX <= (x + width - 1) / tileSize; ++tileX) {
+            if (!readTile(tileX, tileY, tile)) {
+                return false;
+            }
+
+            // Copies the part of the tile that lies inside the region.
+            int left = max(x, tileX * tileSize);
+            int bottom = max(y, tileY * tileSize);
+            int right = min(x + width, tileX * tileSize + tile.getWidth());
+            int top = min(y + height, tileY * tileSize + tile.getHeight());
+            if (!TGAImage::copyPixels(tile.view(left - tileX * tileSize, bottom - tileY * tileSize, right - left, top - bottom),
+                                      region.view(left - x, bottom - y, right - left, top - bottom))) {
+                region = TGAImage();
+                return false;
+            }
+        }
+    }
+    return true;
+};
+
+// Writes an image into the tiles it overlaps.
+bool TiledImage::writeRegion(int x, int y, const TGAImage& region) {
+    int width = region.getWidth();
+    int height = region.getHeight();
+    if (x < 0 || y < 0 || width <= 0 || height <= 0 || x > this->width - width || y > this->height - height) {
+        cout << "Error: Region is outside of the image." << endl;
+        return false;
+    }
+
+    TGAImage tile;
+    for (int tileY = y / tileSize; tileY <= (y + height - 1) / tileSize; ++tileY) {
+        for (int tileX = x / tileSize; tileX <= (x + width - 1) / tileSize; ++tileX) {
+            TGARect rect;
+            getTileRect(tileX, tileY, rect);
+            int left = max(x, rect.x);
+            int bottom = max(y, rect.y);
+            int right = min(x + width, rect.x + rect.width);
+            int top = min(y + height, rect.y + rect.height);
+
+            // Tiles the region covers completely don't need their old pixels.
+            bool covered = left == rect.x && bottom == rect.y && right == rect.x + rect.width && top == rect.y + rect.height;
+            if (covered) {
+                tile = TGAImage(rect.width, rect.height);
+            } else if (!readTile(tileX, tileY, tile)) {
+                return false;
+            }
+
+            if (!TGAImage::copyPixels(region.view(left - x, bottom - y, right - left, top - bottom),
+                                      tile.view(left - rect.x, bottom - rect.y, right - left, top - bottom)) ||
+                !writeTile(tileX, tileY, tile)) {
+                return false;
+            }
+        }
+    }
+    return true;
+};
+
+// Gets the pixel rectangle covered by a tile.
+bool TiledImage::getTileRect(int tileX, int tileY, TGARect& rect) const {
+    if (!file.is_open() || tileX < 0 || tileY < 0 || tileX >= tilesAcross || tileY >= tilesDown) {
+        return false;
+    }
+    rect.x = tileX * tileSize;
+    rect.y = tileY * tileSize;
+    rect.width = min(tileSize, width - rect.x);
+    rect.height = min(tileSize, height - rect.y);
+    return true;
+};
+
+// Writes one index entry to the file. Called with the file lock held.
+bool TiledImage::writeIndexEntry(int tileNumber) {
+    unsigned char entry[INDEX_ENTRY_SIZE] = {};
+    writeLittleEndian(entry, index[tileNumber].offset, 8);
+    writeLittleEndian(entry + 8, index[tileNumber].size, 4);
+    entry[12] = index[tileNumber].encoding;
+
+    file.seekp(HEADER_SIZE + static_cast<streamoff>(tileNumber) * INDEX_ENTRY_SIZE);
+    file.write(reinterpret_cast<const char*>(entry), INDEX_ENTRY_SIZE);
+    if (!file) {
+        file.clear();
+        cout << "Error: Failed to write the tile index." << endl;
+        return false;
+    }
+    return true;
+};
@@ -0,0 +1,89 @@
+#ifndef TILED_IMAGE_H
+#define TILED_IMAGE_H
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "TGAImage.h"
+using namespace std;
+
+
+// Defining a class for big 24-bit images kept on disk as square tiles, so images far past TGA's
+// 32767 pixel and 2 GB limits can be worked on while only reading the tiles a job needs.
+//
+// File layout, all values little-endian:
+//   header (32 bytes)   "TGTL", version, width, height, tileSize, flags (bit 0: compress new tiles), 8 reserved
+//   tile index          16 bytes per tile, rows of tiles from the bottom: data offset (8), data size (4),
+//                       encoding (1: raw, 2: RLE), 3 reserved. An offset of 0 means the tile was never
+//                       written and reads as black.
+//   tile data           each tile is stored like a TGAImage of the tile's size, rows from the bottom in BGR
+//                       order, either raw or as TGA-style RLE packets.
+// Pixel coordinates match TGAImage: (0, 0) is the bottom left. Edge tiles are cut down to the image size.
+//
+// Tiles can be read from several threads at once. A rewritten tile reuses its old space when it fits,
+// otherwise it goes at the end of the file and the old space is left unused.
+class TiledImage {
+public:
+    TiledImage();
+
+    // Creates a new tiled image file, replacing any existing one. Every tile starts out black.
+    // Tiles can be up to 8192 pixels a side.
+    bool create(const string& filename, int width, int height, int tileSize = 256, bool compressed = true);
+
+    // Opens an existing tiled image file for reading and writing.
+    bool open(const string& filename);
+
+    // Closes the file. The index entry of every tile is written along with the tile itself.
+    void close();
+
+    bool isOpen() const;
+    int getWidth() const;
+    int getHeight() const;
+    int getTileSize() const;
+    int getTilesAcross() const;
+    int getTilesDown() const;
+
+    // Reads one tile into an image the size of the tile.
+    bool readTile(int tileX, int tileY, TGAImage& tile);
+
+    // Writes one tile. The image must be the size of the tile.
+    bool writeTile(int tileX, int tileY, const TGAImage& tile);
+
+    // Reads any rectangle of the image, touching only the tiles that overlap it. Returns false if the
+    // rectangle is outside the image or too big for one TGAImage (see TGAImage::validDimensions).
+    bool readRegion(int x, int y, int width, int height, TGAImage& region);
+
+    // Writes an image into the rectangle starting at (x, y). Tiles it only partly covers are read and patched.
+    bool writeRegion(int x, int y, const TGAImage& region);
+
+private:
+    // Defining a structure to hold where a tile's data is in the file.
+    struct TileEntry {
+        uint64_t offset;
+        uint32_t size;
+        unsigned char encoding;
+    };
+
+    fstream file;
+    mutex fileLock;
+    int width;
+    int height;
+    int tileSize;
+    bool compressed;
+    int tilesAcross;
+    int tilesDown;
+    vector<TileEntry> index;
+
+    // Offset just past the last tile's data, where new tiles are appended.
+    uint64_t endOfData;
+
+    // Gets the pixel rectangle covered by a tile, or false if the tile is outside the image.
+    bool getTileRect(int tileX, int tileY, TGARect& rect) const;
+
+    // Writes one index entry to the file.
+    bool writeIndexEntry(int tileNumber);
+};
+
+#endif // TILED_IMAGE_H
@@ -1,278 +1,249 @@
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
 #include <iostream>
 #include <fstream>
+#include "FrameSequence.h"
+#include "ImageIndex.h"
+#include "ImageServer.h"
 #include "TGAImage.h"
+#include "TaskGraph.h"
 using namespace std;
 
 
-int main() {
-
-    /***** Part 1 *****/
-    cout << "Part 1" << endl;
-
-    // Loading in layer1 and pattern1.
-    TGAImage layer1;
-    cout << "Loading layer1.tga..." << endl;
-    layer1.loadTGA("input/layer1.tga");
-
-    TGAImage pattern1;
-    cout << "Loading pattern1.tga..." << endl;
-    pattern1.loadTGA("input/pattern1.tga");
-
-    // Creating a TGAImage object to store the result of the multiplication, and then multiplying.
-    TGAImage part1;
-    part1 = TGAImage::multiplyImages(layer1, pattern1);
-
-    // Checking if the result image is empty (dimension mismatch)
-    if (part1.getWidth() == 0 || part1.getHeight() == 0) {
+// Adds a stage to the graph that loads a TGA file.
+int addLoadStage(TaskGraph& graph, const string& name, const string& filename) {
+    return graph.addStage(name, vector<int>(), [=](const vector<const TGAImage*>&, TGAImage& output) {
+        cout << "Loading " << name << ".tga..." << endl;
+        return output.loadTGA(filename);
+    });
+};
+
+// Blends two images into a buffer the graph reuses from outputs no stage needs anymore.
+bool blendInto(TaskGraph& graph, TGAImage::BlendFunction blend, const TGAImage& topLayer, const TGAImage& bottomLayer,
+               TGAImage& output) {
+    output = graph.acquireImage(topLayer.getWidth(), topLayer.getHeight());
+    return blend(topLayer.view(), bottomLayer.view(), output.view());
+};
+
+// Saves the result of a part, checking that the result isn't empty (dimension mismatch).
+bool saveResult(const TGAImage& result, const string& filename) {
+    if (result.getWidth() == 0 || result.getHeight() == 0) {
         cout << "Error: Result image is empty. Dimension mismatch." << endl;
-        return 1;
+        return false;
     }
 
-    // Saving the result image to a new file.
-    string outputPart1 = "output/part1.tga";
-    bool successPart1 = part1.saveTGA(outputPart1);
-    if (!successPart1) {
+    if (!result.saveTGA(filename)) {
         cout << "Error: Failed to save the result image." << endl;
-        return 1;
-    }
+        return false;
+    }
+
+    cout << "Result image saved successfully to file: " << filename << endl;
+    return true;
+};
+
+// Parses a whole argument as a non-negative integer, printing an error naming it if it isn't one.
+bool parseCount(const char* text, const string& name, int& value) {
+    char* end = nullptr;
+    errno = 0;
+    long parsed = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || errno == ERANGE || parsed < 0 || parsed > INT_MAX) {
+        cout << "Error: The " << name << " must be a non-negative whole number, not " << text << "." << endl;
+        return false;
+    }
+    value = static_cast<int>(parsed);
+    return true;
+};
+
+int main(int argc, char* argv[]) {
+
+    // "project2 --serve <socket>" keeps running and takes jobs over a Unix domain socket instead.
+    if (argc >= 3 && string(argv[1]) == "--serve") {
+        ImageServer server(argv[2]);
+        return server.run() ? 0 : 1;
+    }
+
+    // "project2 --sequence <operation> <windowSize> <inputPattern> <firstFrame> <lastFrame> <outputPattern>"
+    // runs a temporal operation (difference, average, median or motion) over a numbered frame sequence.
+    if (argc >= 8 && string(argv[1]) == "--sequence") {
+        string operationName = argv[2];
+        FrameSequence::TemporalOperation operation;
+        if (operationName == "difference") {
+            operation = FrameSequence::FrameDifference;
+        } else if (operationName == "average") {
+            operation = FrameSequence::RunningAverage;
+        } else if (operationName == "median") {
+            operation = FrameSequence::RunningMedian;
+        } else if (operationName == "motion") {
+            operation = FrameSequence::MotionMask;
+        } else {
+            cout << "Error: Unknown sequence operation " << operationName << "." << endl;
+            return 1;
+        }
+
+        int windowSize, firstFrame, lastFrame;
+        if (!parseCount(argv[3], "window size", windowSize) || !parseCount(argv[5], "first frame", firstFrame) ||
+            !parseCount(argv[6], "last frame", lastFrame)) {
+            return 1;
+        }
+        if (windowSize < 1) {
+            cout << "Error: The window size must be at least 1." << endl;
+            return 1;
+        }
+        if (firstFrame > lastFrame) {
+            cout << "Error: The first frame " << firstFrame << " comes after the last frame " << lastFrame << "." << endl;
+            return 1;
+        }
+        // Without a run of '#' every frame's result would overwrite the same file.
+        if (string(argv[7]).find('#') == string::npos) {
+            cout << "Error: The output pattern " << argv[7] << " needs a run of '#' for the frame number." << endl;
+            return 1;
+        }
+
+        FrameSequence sequence(argv[4], firstFrame, lastFrame);
+        return sequence.process(operation, windowSize, argv[7]) ? 0 : 1;
+    }
+
+    // "project2 --index <indexFile> <directory>..." reads the headers of every image under the directories
+    // into a metadata index, only probing files that changed since the index was last written.
+    if (argc >= 4 && string(argv[1]) == "--index") {
+        ImageIndex index;
+        index.load(argv[2]);
+        // A directory that can't be read would drop its files from the index, so the old index is kept.
+        if (!index.scan(vector<string>(argv + 3, argv + argc)) || !index.save(argv[2])) {
+            return 1;
+        }
+
+        vector<vector<size_t> > groups = index.groupByShape();
+        cout << "Indexed " << index.getEntries().size() << " images (" << index.getProbedCount() << " probed) in "
+             << groups.size() << " shapes." << endl;
+        for (size_t i = 0; i < groups.size(); ++i) {
+            const TGAImageInfo& info = index.getEntries()[groups[i][0]].info;
+            cout << "  " << info.width << "x" << info.height << ": " << groups[i].size() << " images" << endl;
+        }
+
+        // Files with a header loadImage refuses are indexed but belong to no shape.
+        size_t unloadable = 0;
+        for (size_t i = 0; i < index.getEntries().size(); ++i) {
+            unloadable += index.getEntries()[i].info.loadable ? 0 : 1;
+        }
+        if (unloadable > 0) {
+            cout << "  " << unloadable << " images can't be loaded" << endl;
+        }
+        return 0;
+    }
+
+    // Every input and part is a stage of a task graph. Stages only wait for the stages they read from,
+    // so independent parts (1, 2, 5, 6, 7 and 10 share no intermediates) run at the same time.
+    TaskGraph graph;
+
+    int layer1 = addLoadStage(graph, "layer1", "input/layer1.tga");
+    int pattern1 = addLoadStage(graph, "pattern1", "input/pattern1.tga");
+    int layer2 = addLoadStage(graph, "layer2", "input/layer2.tga");
+    int car = addLoadStage(graph, "car", "input/car.tga");
+    int pattern2 = addLoadStage(graph, "pattern2", "input/pattern2.tga");
+    int text = addLoadStage(graph, "text", "input/text.tga");
+    int circles = addLoadStage(graph, "circles", "input/circles.tga");
+    int layerRed = addLoadStage(graph, "layer_red", "input/layer_red.tga");
+    int layerGreen = addLoadStage(graph, "layer_green", "input/layer_green.tga");
+    int layerBlue = addLoadStage(graph, "layer_blue", "input/layer_blue.tga");
+    int text2 = addLoadStage(graph, "text2", "input/text2.tga");
 
-    cout << "Result image saved successfully to file: " << outputPart1 << endl;
+    /***** Part 1 *****/
+    // Multiplying layer1 with pattern1.
+    graph.addStage("Part 1", { layer1, pattern1 }, [&graph](const vector<const TGAImage*>& inputs, TGAImage& output) {
+        return blendInto(graph, &TGAImage::multiplyImages, *inputs[0], *inputs[1], output) &&
+               saveResult(output, "output/part1.tga");
+    });
 
     /***** Part 2 *****/
-    cout << "Part 2" << endl;
-
-    // Loading in layer2 and car.
-    TGAImage layer2;
-    cout << "Loading layer2.tga..." << endl;
-    layer2.loadTGA("input/layer2.tga");
-
-    TGAImage car;
-    cout << "Loading car.tga..." << endl;
-    car.loadTGA("input/car.tga");
-
-    // Creating a TGAImage object to store the result of the subraction, and then subtracting.
-    TGAImage part2;
-    part2 = TGAImage::subtractImages(layer2, car);
-
-    // Checking if the result image is empty (dimension mismatch)
-    if (part2.getWidth() == 0 || part2.getHeight() == 0) {
-        cout << "Error: Result image is empty. Dimension mismatch." << endl;
-        return 1;
-    }
-
-    // Saving the result image to a new file.
-    string outputPart2 = "output/part2.tga";
-    bool successPart2 = part2.saveTGA(outputPart2);
-    if (!successPart2) {
-        cout << "Error: Failed to save the result image." << endl;
-        return 1;
-    }
-
-    cout << "Result image saved successfully to file: " << outputPart2 << endl;
+    // Subtracting layer2 from car.
+    graph.addStage("Part 2", { layer2, car }, [&graph](const vector<const TGAImage*>& inputs, TGAImage& output) {
+        return blendInto(graph, &TGAImage::subtractImages, *inputs[0], *inputs[1], output) &&
+               saveResult(output, "output/part2.tga");
+    });
 
     /***** Part 3 *****/
-    cout << "Part 3" << endl;
-
-    // Loading in pattern2 and text, layer1 was loaded in previously.
-    TGAImage pattern2;
-    cout << "Loading pattern2.tga..." << endl;
-    pattern2.loadTGA("input/pattern2.tga");
-
-    TGAImage text;
-    cout << "Loading text.tga..." << endl;
-    text.loadTGA("input/text.tga");
+    // Multiplying layer1 with pattern2, then screening text over the result.
+    int part3Mult = graph.addStage("Part 3 multiply", { layer1, pattern2 },
+        [&graph](const vector<const TGAImage*>& inputs, TGAImage& output) {
+            return blendInto(graph, &TGAImage::multiplyImages, *inputs[0], *inputs[1], output);
+        });
 
-    // Creating a TGAImage object to store the result of the multiplication, and then multiplying.
-    TGAImage part3Mult;
-    part3Mult = TGAImage::multiplyImages(layer1, pattern2);
-
-    // Creating a TGAImage object to store the result of the screen, then screening.
-    TGAImage part3;
-    part3 = TGAImage::screenImages(text, part3Mult);
-
-    // Checking if the result image is empty (dimension mismatch)
-    if (part3.getWidth() == 0 || part3.getHeight() == 0) {
-        cout << "Error: Result image is empty. Dimension mismatch." << endl;
-        return 1;
-    }
-
-    // Saving the result image to a new file.
-    string outputPart3 = "output/part3.tga";
-    bool successPart3 = part3.saveTGA(outputPart3);
-    if (!successPart3) {
-        cout << "Error: Failed to save the result image." << endl;
-        return 1;
-    }
-
-    cout << "Result image saved successfully to file: " << outputPart3 << endl;
+    graph.addStage("Part 3", { text, part3Mult }, [&graph](const vector<const TGAImage*>& inputs, TGAImage& output) {
+        return blendInto(graph, &TGAImage::screenImages, *inputs[0], *inputs[1], output) &&
+               saveResult(output, "output/part3.tga");
+    });
 
     /***** Part 4 *****/
-    cout << "Part 4" << endl;
-
-    // Loading in circles, layer2 and pattern2 were loaded in previously.
-    TGAImage circles;
-    cout << "Loading circles.tga..." << endl;
-    circles.loadTGA("input/circles.tga");
-
-    // Creating a TGAImage object to store the result of the multiplication, and then multiplying.
-    TGAImage part4Mult;
-    part4Mult = TGAImage::multiplyImages(layer2, circles);
+    // Multiplying layer2 with circles, then subtracting pattern2 from the result.
+    int part4Mult = graph.addStage("Part 4 multiply", { layer2, circles },
+        [&graph](const vector<const TGAImage*>& inputs, TGAImage& output) {
+            return blendInto(graph, &TGAImage::multiplyImages, *inputs[0], *inputs[1], output);
+        });
 
-    // Creating a TGAImage object to store the result of the subtraction, and then subtracting.
-    TGAImage part4;
-    part4 = TGAImage::subtractImages(pattern2, part4Mult);
-
-    // Checking if the result image is empty (dimension mismatch)
-    if (part4.getWidth() == 0 || part4.getHeight() == 0) {
-        cout << "Error: Result image is empty. Dimension mismatch." << endl;
-        return 1;
-    }
-
-    // Saving the result image to a new file.
-    string outputPart4 = "output/part4.tga";
-    bool successPart4 = part4.saveTGA(outputPart4);
-    if (!successPart4) {
-        cout << "Error: Failed to save the result image." << endl;
-        return 1;
-    }
-
-    cout << "Result image saved successfully to file: " << outputPart4 << endl;
+    graph.addStage("Part 4", { pattern2, part4Mult }, [&graph](const vector<const TGAImage*>& inputs, TGAImage& output) {
+        return blendInto(graph, &TGAImage::subtractImages, *inputs[0], *inputs[1], output) &&
+               saveResult(output, "output/part4.tga");
+    });
 
     /***** Part 5 *****/
-    cout << "Part 5" << endl;
-
-    // Creating a TGAImage object to store the result of the overlay, then overlaying.
-    TGAImage part5;
-    part5 = TGAImage::overlayImages(pattern1, layer1);
-
-    // Checking if the result image is empty (dimension mismatch)
-    if (part5.getWidth() == 0 || part5.getHeight() == 0) {
-        cout << "Error: Result image is empty. Dimension mismatch." << endl;
-        return 1;
-    }
-
-    // Saving the result image to a new file.
-    string outputPart5 = "output/part5.tga";
-    bool successPart5 = part5.saveTGA(outputPart5);
-    if (!successPart5) {
-        cout << "Error: Failed to save the result image." << endl;
-        return 1;
-    }
-
-    cout << "Result image saved successfully to file: " << outputPart5 << endl;
+    // Overlaying layer1 onto pattern1.
+    graph.addStage("Part 5", { pattern1, layer1 }, [&graph](const vector<const TGAImage*>& inputs, TGAImage& output) {
+        return blendInto(graph, &TGAImage::overlayImages, *inputs[0], *inputs[1], output) &&
+               saveResult(output, "output/part5.tga");
+    });
 
     /***** Part 6 *****/
-    cout << "Part 6" << endl;
-
-    // Creating a TGAImage object to store the result, then adding 200 Green to car.
-    TGAImage part6;
-    part6 = TGAImage::add200Green(car);
-
-    // Saving the result image to a new file.
-    string outputPart6 = "output/part6.tga";
-    bool successPart6 = part6.saveTGA(outputPart6);
-    if (!successPart6) {
-        cout << "Error: Failed to save the result image." << endl;
-        return 1;
-    }
-
-    cout << "Result image saved successfully to file: " << outputPart6 << endl;
+    // Adding 200 green to car.
+    graph.addStage("Part 6", { car }, [&graph](const vector<const TGAImage*>& inputs, TGAImage& output) {
+        output = graph.acquireImage(inputs[0]->getWidth(), inputs[0]->getHeight());
+        return TGAImage::add200Green(inputs[0]->view(), output.view()) && saveResult(output, "output/part6.tga");
+    });
 
     /***** Part 7 *****/
-    cout << "Part 7" << endl;
-
-    // Creating a TGAImage object to store the result, 
-    // then multiplying the red channel by 4 and the blue by 0.
-    TGAImage part7;
-    part7 = TGAImage::scaleChannels(car, 4.0, 0.0);
-
-    // Saving the result image to a new file.
-    string outputPart7 = "output/part7.tga";
-    bool successPart7 = part7.saveTGA(outputPart7);
-    if (!successPart7) {
-        cout << "Error: Failed to save the result image." << endl;
-        return 1;
-    }
-
-    cout << "Result image saved successfully to file: " << outputPart7 << endl;
+    // Multiplying the red channel of car by 4 and the blue by 0.
+    graph.addStage("Part 7", { car }, [&graph](const vector<const TGAImage*>& inputs, TGAImage& output) {
+        output = graph.acquireImage(inputs[0]->getWidth(), inputs[0]->getHeight());
+        return TGAImage::scaleChannels(inputs[0]->view(), 4.0, 0.0, output.view()) && saveResult(output, "output/part7.tga");
+    });
 
     /***** Part 8 *****/
-    cout << "Part 8" << endl;
-
-    // Separating and saving channels.
-    bool result = TGAImage::separateChannels(car, "output/part8_r.tga", "output/part8_g.tga", "output/part8_b.tga");
-    if (!result) {
-        std::cout << "Error separating channels." << std::endl;
-        return 1;
-    }
+    // Separating and saving the channels of car.
+    graph.addStage("Part 8", { car }, [](const vector<const TGAImage*>& inputs, TGAImage&) {
+        bool result = TGAImage::separateChannels(*inputs[0], "output/part8_r.tga", "output/part8_g.tga", "output/part8_b.tga");
+        if (!result) {
+            cout << "Error separating channels." << endl;
+        }
+        return result;
+    });
 
     /***** Part 9 *****/
-    cout << "Part 9" << endl;
-
-    // Creating TGAImage objects for the different layers, and loading them in.
-    TGAImage layerRed;
-    TGAImage layerGreen;
-    TGAImage layerBlue;
-
-    layerRed.loadTGA("input/layer_red.tga");
-    layerGreen.loadTGA("input/layer_green.tga");
-    layerBlue.loadTGA("input/layer_blue.tga");
-
-    // Creating a TGAImage object to store the result and combining the layers.
-    TGAImage part9;
-    part9 = TGAImage::combineChannels(layerRed, layerGreen, layerBlue);
-
-    // Saving the result image to a new file.
-    string outputPart9 = "output/part9.tga";
-    bool successPart9 = part9.saveTGA(outputPart9);
-    if (!successPart9) {
-        cout << "Error: Failed to save the result image." << endl;
-        return 1;
-    }
-
-    cout << "Result image saved successfully to file: " << outputPart9 << endl;
+    // Combining the red, green and blue layers into one image.
+    graph.addStage("Part 9", { layerRed, layerGreen, layerBlue }, [](const vector<const TGAImage*>& inputs, TGAImage& output) {
+        output = TGAImage::combineChannels(*inputs[0], *inputs[1], *inputs[2]);
+        return saveResult(output, "output/part9.tga");
+    });
 
     /***** PART 10 *****/
-    cout << "Part 10" << endl;
-
-    // Creating a TGAImage object for text2 and loading it in.
-    TGAImage text2;
-    text2.loadTGA("input/text2.tga");
-
-    // Creating a TGAImage object to store the flipped image, and flipping it.
-    TGAImage part10;
-    part10 = TGAImage::flipImage180(text2);
-
-    // Saving the result image to a new file.
-    string outputPart10 = "output/part10.tga";
-    bool successPart10 = part10.saveTGA(outputPart10);
-    if (!successPart10) {
-        cout << "Error: Failed to save the result image." << endl;
-        return 1;
-    }
-
-    cout << "Result image saved successfully to file: " << outputPart10 << endl;
+    // Flipping text2 180 degrees.
+    graph.addStage("Part 10", { text2 }, [](const vector<const TGAImage*>& inputs, TGAImage& output) {
+        output = TGAImage::flipImage180(*inputs[0]);
+        return saveResult(output, "output/part10.tga");
+    });
 
     /***** Extra Credit *****
-    cout << "Extra Credit" << endl;
-
-    //Loading in text1.
-    TGAImage text1;
-    text1.loadTGA("input/text1.tga");
-
-    // Creating a TGAImage object to store the grid image, and producing it.
-    TGAImage extraCredit;
-    extraCredit = TGAImage::gridImage(text1, pattern1, car, circles);
-
-    // Saving the result image to a new file.
-    string outputEC = "output/extracredit.tga";
-    bool successEC = extraCredit.saveTGA(outputEC);
-    if (!successEC) {
-        cout << "Error: Failed to save the result image." << endl;
-        return 1;
-    }
-
-    cout << "Result image saved successfully to file: " << outputEC << endl;
+    // Making a 2x2 grid out of text1, pattern1, car and circles.
+    int text1 = addLoadStage(graph, "text1", "input/text1.tga");
+    graph.addStage("Extra Credit", { text1, pattern1, car, circles }, [](const vector<const TGAImage*>& inputs, TGAImage& output) {
+        output = TGAImage::gridImage(*inputs[0], *inputs[1], *inputs[2], *inputs[3]);
+        return saveResult(output, "output/extracredit.tga");
+    });
     */
-    return 0;
-};
\ No newline at end of file
+
+    // Running the graph, any failed stage makes the whole run fail. Each image is freed once the last
+    // part reading it is done, and its buffer is reused by the parts after it.
+    bool success = graph.run();
+    cout << "Peak image memory: " << graph.getPeakBytes() << " bytes" << endl;
+    return success ? 0 : 1;
+};
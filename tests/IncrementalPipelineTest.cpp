@@ -0,0 +1,67 @@
+#include <iostream>
+#include "../src/IncrementalPipeline.h"
+using namespace std;
+
+
+// Regression checks for IncrementalPipeline. Prints each failure and exits with 1 if any check failed.
+namespace {
+
+int failures = 0;
+
+// Records a failed check.
+void check(bool condition, const string& what) {
+    if (!condition) {
+        cout << "FAILED: " << what << endl;
+        ++failures;
+    }
+};
+
+// Makes an image with every channel of every pixel set to value.
+TGAImage filledImage(int width, int height, unsigned char value) {
+    TGAImage image(width, height);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            image.setPixelColor(x, y, value, value, value);
+        }
+    }
+    return image;
+};
+
+// Gets the red channel of a pixel.
+int redAt(const TGAImage& image, int x, int y) {
+    unsigned char red, green, blue;
+    image.getPixelColor(x, y, red, green, blue);
+    return red;
+};
+
+}
+
+int main() {
+    TGAImage top = filledImage(8, 8, 100);
+    TGAImage bottom = filledImage(8, 8, 200);
+
+    IncrementalPipeline pipeline;
+    int blend = pipeline.addBlend("multiply", pipeline.addSource(&top), pipeline.addSource(&bottom));
+    check(pipeline.evaluate() && redAt(pipeline.getOutput(blend), 3, 3) == 78, "first evaluate");
+
+    // Assigning a whole new image to a source has to be seen as a change to all of it.
+    top = filledImage(8, 8, 255);
+    check(pipeline.evaluate() && redAt(pipeline.getOutput(blend), 3, 3) == 200, "copy-assigned source");
+    check(pipeline.getUpdatedRects(blend).size() == 1 && pipeline.getUpdatedRects(blend)[0].width == 8,
+          "copy-assigned source updates the whole result");
+
+    TGAImage white = filledImage(8, 8, 255);
+    top = TGAImage::screenImages(white, filledImage(8, 8, 0));
+    check(pipeline.evaluate() && redAt(pipeline.getOutput(blend), 3, 3) == 200, "move-assigned blend result");
+
+    top = filledImage(8, 8, 0);
+    check(pipeline.evaluate() && redAt(pipeline.getOutput(blend), 3, 3) == 0, "second assignment");
+
+    // With nothing changed, nothing is recomputed.
+    check(pipeline.evaluate() && pipeline.getUpdatedRects(blend).empty(), "unchanged sources");
+
+    if (failures == 0) {
+        cout << "All IncrementalPipeline checks passed." << endl;
+    }
+    return failures == 0 ? 0 : 1;
+};